@@ -0,0 +1,189 @@
+#include "chunk.h"
+#include "terrain_generator.h"
+#include <benchmark/benchmark.h>
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <unordered_map>
+
+// heap allocations per chunk through its life: construction, generation and
+// meshing. The face atlas benchmarks compare the shared BLOCK_FACE_ATLAS table
+// against the per chunk map of maps it replaced, which every chunk built on
+// construction and the mesher copied an inner map of per solid voxel
+
+static std::atomic<int64_t> allocation_count = 0;
+
+void* operator new(size_t size) {
+  allocation_count.fetch_add(1, std::memory_order_relaxed);
+  if (void* p = std::malloc(size == 0 ? 1 : size)) {
+    return p;
+  }
+  throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+  std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+  std::free(p);
+}
+
+namespace {
+
+using FaceAtlasMap =
+    std::unordered_map<VoxelType, std::unordered_map<BlockFaces, int>>;
+
+// the map every chunk used to carry
+FaceAtlasMap create_face_atlas_map() {
+  FaceAtlasMap map;
+  for (auto voxel_type : {VoxelType::DIRT, VoxelType::GRASS, VoxelType::STONE,
+                          VoxelType::WATER, VoxelType::WOOD}) {
+    for (auto face = 0; face < 6; face++) {
+      map[voxel_type][(BlockFaces)face] =
+          BLOCK_FACE_ATLAS[(int)voxel_type][face];
+    }
+  }
+  return map;
+}
+
+// allocations made since it was created, per iteration of the benchmark
+class AllocationCounter {
+private:
+  int64_t start = allocation_count.load(std::memory_order_relaxed);
+
+public:
+  void report(benchmark::State& state) const {
+    int64_t count = allocation_count.load(std::memory_order_relaxed) - start;
+    state.counters["allocations"] =
+        (double)count / std::max<int64_t>(state.iterations(), 1);
+  }
+};
+
+struct World {
+  TerrainGenerator terrain_generator{1234};
+  // center, front, back, left, right
+  std::unique_ptr<Chunk> chunks[5];
+
+  World() {
+    ChunkPos positions[5] = {
+        {.x = 0, .z = 0},  {.x = 0, .z = 1}, {.x = 0, .z = -1},
+        {.x = -1, .z = 0}, {.x = 1, .z = 0},
+    };
+    for (auto i = 0; i < 5; i++) {
+      chunks[i] = std::make_unique<Chunk>(positions[i], terrain_generator);
+      chunks[i]->mark_queued();
+      chunks[i]->generate();
+    }
+  }
+};
+
+World& get_world() {
+  static World world;
+  return world;
+}
+
+} // namespace
+
+// NOTE: includes the allocation of the chunk itself, chunk_grid constructs
+// chunks in place in a slot it already owns
+static void BM_ConstructChunk(benchmark::State& state) {
+  auto& terrain_generator = get_world().terrain_generator;
+  AllocationCounter counter;
+  for (auto _ : state) {
+    auto chunk =
+        std::make_unique<Chunk>(ChunkPos{.x = 0, .z = 0}, terrain_generator);
+    benchmark::DoNotOptimize(chunk.get());
+  }
+  counter.report(state);
+}
+BENCHMARK(BM_ConstructChunk);
+
+static void BM_GenerateChunk(benchmark::State& state) {
+  auto& terrain_generator = get_world().terrain_generator;
+  int64_t allocations = 0;
+  for (auto _ : state) {
+    state.PauseTiming();
+    auto chunk =
+        std::make_unique<Chunk>(ChunkPos{.x = 0, .z = 0}, terrain_generator);
+    chunk->mark_queued();
+    int64_t before = allocation_count.load(std::memory_order_relaxed);
+    state.ResumeTiming();
+
+    chunk->generate();
+
+    state.PauseTiming();
+    allocations += allocation_count.load(std::memory_order_relaxed) - before;
+    chunk.reset();
+    state.ResumeTiming();
+  }
+  state.counters["allocations"] =
+      (double)allocations / std::max<int64_t>(state.iterations(), 1);
+}
+BENCHMARK(BM_GenerateChunk);
+
+static void BM_MeshChunkAllocations(benchmark::State& state) {
+  auto& world = get_world();
+  auto& chunk = *world.chunks[0];
+  AllocationCounter counter;
+  for (auto _ : state) {
+    chunk.request_mesh_creation(MeshingMode::GREEDY, *world.chunks[1],
+                                *world.chunks[2], *world.chunks[3],
+                                *world.chunks[4]);
+    chunk.create_mesh();
+  }
+  counter.report(state);
+}
+BENCHMARK(BM_MeshChunkAllocations);
+
+// looking up the atlas index of every face of every solid voxel of a chunk,
+// the way the naive mesher did before and after
+static void BM_FaceAtlasMap(benchmark::State& state) {
+  const auto& chunk = *get_world().chunks[0];
+  AllocationCounter counter;
+  for (auto _ : state) {
+    auto map = create_face_atlas_map();
+    int sum = 0;
+    for (auto s = 0; s < SECTIONS_PER_CHUNK; s++) {
+      const auto& voxels = chunk.get_section(s).voxels;
+      for (auto i = 0; i < SECTION_VOLUME; i++) {
+        auto voxel_type = voxels.get(i);
+        if (voxel_type == VoxelType::AIR) {
+          continue;
+        }
+        std::unordered_map<BlockFaces, int> faces = map[voxel_type];
+        for (auto face = 0; face < 6; face++) {
+          sum += faces[(BlockFaces)face];
+        }
+      }
+    }
+    benchmark::DoNotOptimize(sum);
+  }
+  counter.report(state);
+}
+BENCHMARK(BM_FaceAtlasMap);
+
+static void BM_FaceAtlasTable(benchmark::State& state) {
+  const auto& chunk = *get_world().chunks[0];
+  AllocationCounter counter;
+  for (auto _ : state) {
+    int sum = 0;
+    for (auto s = 0; s < SECTIONS_PER_CHUNK; s++) {
+      const auto& voxels = chunk.get_section(s).voxels;
+      for (auto i = 0; i < SECTION_VOLUME; i++) {
+        auto voxel_type = voxels.get(i);
+        if (voxel_type == VoxelType::AIR) {
+          continue;
+        }
+        for (auto face = 0; face < 6; face++) {
+          sum += BLOCK_FACE_ATLAS[(int)voxel_type][face];
+        }
+      }
+    }
+    benchmark::DoNotOptimize(sum);
+  }
+  counter.report(state);
+}
+BENCHMARK(BM_FaceAtlasTable);
@@ -0,0 +1,76 @@
+#include "frustum.h"
+#include <benchmark/benchmark.h>
+#include <cmath>
+#include <vector>
+
+// frustum culling the section boxes of a 26x26 chunk area (10816 boxes), all
+// at once with Frustum::test_bounding_boxes (8 at a time with avx) against one
+// at a time with test_bounding_box. The camera turns a little every iteration
+// so the branches in the scalar path don't settle
+
+namespace {
+
+static constexpr int RADIUS = 13;
+
+BoundingBoxList create_section_boxes() {
+  BoundingBoxList boxes;
+  for (auto x = -RADIUS; x < RADIUS; x++) {
+    for (auto z = -RADIUS; z < RADIUS; z++) {
+      for (auto section = 0; section < SECTIONS_PER_CHUNK; section++) {
+        float x_offset = x * CHUNK_WIDTH;
+        float z_offset = z * CHUNK_DEPTH;
+        boxes.push_back(BoundingBox{
+            .min = glm::vec3(x_offset, section * SECTION_SIZE,
+                             z_offset - CHUNK_DEPTH),
+            .max = glm::vec3(x_offset + CHUNK_WIDTH,
+                             (section + 1) * SECTION_SIZE, z_offset)});
+      }
+    }
+  }
+  return boxes;
+}
+
+void point_camera(Frustum& frustum, int64_t step) {
+  static const auto projection =
+      glm::perspective(glm::radians(70.0f), 16.0f / 9.0f, 0.1f, 500.0f);
+  float yaw = step * 0.01f;
+  auto eye = glm::vec3(0.0f, 100.0f, 0.0f);
+  auto direction = glm::vec3(std::cos(yaw), -0.3f, std::sin(yaw));
+  frustum.create_frustum_from_camera(
+      projection *
+      glm::lookAt(eye, eye + direction, glm::vec3(0.0f, 1.0f, 0.0f)));
+}
+
+} // namespace
+
+static void BM_FrustumBatched(benchmark::State& state) {
+  auto boxes = create_section_boxes();
+  Frustum frustum;
+  std::vector<uint64_t> visible;
+  int64_t step = 0;
+  for (auto _ : state) {
+    point_camera(frustum, step++);
+    frustum.test_bounding_boxes(boxes, visible);
+    benchmark::DoNotOptimize(visible.data());
+  }
+  state.SetItemsProcessed(state.iterations() * boxes.size());
+}
+BENCHMARK(BM_FrustumBatched)->Unit(benchmark::kMicrosecond);
+
+static void BM_FrustumScalar(benchmark::State& state) {
+  auto boxes = create_section_boxes();
+  Frustum frustum;
+  std::vector<uint64_t> visible;
+  int64_t step = 0;
+  for (auto _ : state) {
+    point_camera(frustum, step++);
+    visible.assign((boxes.size() + 63) / 64, 0);
+    for (size_t i = 0; i < boxes.size(); i++) {
+      visible[i / 64] |= (uint64_t)frustum.test_bounding_box(boxes.get(i))
+                         << (i % 64);
+    }
+    benchmark::DoNotOptimize(visible.data());
+  }
+  state.SetItemsProcessed(state.iterations() * boxes.size());
+}
+BENCHMARK(BM_FrustumScalar)->Unit(benchmark::kMicrosecond);
@@ -0,0 +1,73 @@
+#include "chunk.h"
+#include "terrain_generator.h"
+#include <benchmark/benchmark.h>
+#include <map>
+#include <memory>
+#include <utility>
+
+// every mesher over the same generated terrain. An iteration meshes each chunk
+// of an AREA x AREA patch once, snapshot included, which is what a mesh worker
+// spends per chunk
+
+namespace {
+
+static constexpr int AREA = 10;
+
+// the patch plus a ring of neighbours around it
+struct World {
+  TerrainGenerator terrain_generator{1234};
+  std::map<std::pair<int, int>, std::unique_ptr<Chunk>> chunks;
+
+  World() {
+    for (auto x = -1; x <= AREA; x++) {
+      for (auto z = -1; z <= AREA; z++) {
+        auto chunk = std::make_unique<Chunk>(ChunkPos{.x = x, .z = z},
+                                             terrain_generator);
+        chunk->mark_queued();
+        chunk->generate();
+        chunks[{x, z}] = std::move(chunk);
+      }
+    }
+  }
+
+  Chunk& get(int x, int z) {
+    return *chunks.at({x, z});
+  }
+};
+
+World& get_world() {
+  static World world;
+  return world;
+}
+
+} // namespace
+
+static void BM_MeshTerrain(benchmark::State& state) {
+  auto& world = get_world();
+  auto meshing_mode = (MeshingMode)state.range(0);
+  size_t vertex_count = 0;
+  for (auto _ : state) {
+    vertex_count = 0;
+    for (auto x = 0; x < AREA; x++) {
+      for (auto z = 0; z < AREA; z++) {
+        auto& chunk = world.get(x, z);
+        chunk.request_mesh_creation(meshing_mode, world.get(x, z + 1),
+                                    world.get(x, z - 1), world.get(x - 1, z),
+                                    world.get(x + 1, z));
+        chunk.create_mesh();
+        for (auto s = 0; s < SECTIONS_PER_CHUNK; s++) {
+          vertex_count += chunk.get_section(s).vertices_buffer.size();
+        }
+      }
+    }
+  }
+  state.SetLabel(get_meshing_mode_name(meshing_mode));
+  state.SetItemsProcessed(state.iterations() * AREA * AREA);
+  state.counters["vertices_per_chunk"] =
+      (double)vertex_count / (AREA * AREA);
+}
+BENCHMARK(BM_MeshTerrain)
+    ->Arg((int)MeshingMode::NAIVE)
+    ->Arg((int)MeshingMode::GREEDY)
+    ->Arg((int)MeshingMode::BINARY)
+    ->Unit(benchmark::kMillisecond);
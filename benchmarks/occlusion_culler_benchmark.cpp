@@ -0,0 +1,67 @@
+#include "occlusion_culler.h"
+#include <benchmark/benchmark.h>
+#include <glm/gtc/matrix_transform.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <vector>
+
+// one occlusion pass over the ground of a 21x21 chunk area (441 occluders)
+// and the sections above it, seen from above the ground looking a little down.
+// The camera turns a little every iteration
+
+namespace {
+
+static constexpr int RADIUS = 10;
+
+struct Scene {
+  std::vector<BoundingBox> ground;
+  BoundingBoxList sections;
+
+  Scene() {
+    for (auto x = -RADIUS; x <= RADIUS; x++) {
+      for (auto z = -RADIUS; z <= RADIUS; z++) {
+        float height =
+            60 + (int)(25.0f + 25.0f * std::sin(x * 0.5f) * std::cos(z * 0.4f));
+        float x_offset = x * CHUNK_WIDTH;
+        float z_offset = z * CHUNK_DEPTH;
+        ground.push_back(BoundingBox{
+            .min = glm::vec3(x_offset, 0.0f, z_offset - CHUNK_DEPTH),
+            .max = glm::vec3(x_offset + CHUNK_WIDTH, height, z_offset)});
+        for (auto s = 3; s * SECTION_SIZE < height + 8; s++) {
+          float top = std::min<float>((s + 1) * SECTION_SIZE, height + 8);
+          sections.push_back(BoundingBox{
+              .min = glm::vec3(x_offset, s * SECTION_SIZE,
+                               z_offset - CHUNK_DEPTH),
+              .max = glm::vec3(x_offset + CHUNK_WIDTH, top, z_offset)});
+        }
+      }
+    }
+  }
+};
+
+} // namespace
+
+static void BM_OcclusionPass(benchmark::State& state) {
+  Scene scene;
+  OcclusionCuller culler;
+  auto projection =
+      glm::perspective(glm::radians(70.0f), 16.0f / 9.0f, 0.1f, 1000.0f);
+  auto eye = glm::vec3(8.0f, 120.0f, -8.0f);
+  int64_t step = 0;
+  double pass_time_ms = 0.0;
+  for (auto _ : state) {
+    float yaw = step++ * 0.01f;
+    auto direction = glm::vec3(std::cos(yaw), -0.2f, std::sin(yaw));
+    culler.begin_pass(
+        projection *
+            glm::lookAt(eye, eye + direction, glm::vec3(0.0f, 1.0f, 0.0f)),
+        scene.ground, scene.sections);
+    benchmark::DoNotOptimize(culler.wait_for_pass(std::chrono::seconds(10)));
+    pass_time_ms += culler.get_pass_time();
+  }
+  // NOTE: the pass on the worker thread alone, without the hand over
+  state.counters["pass_ms"] =
+      pass_time_ms / std::max<int64_t>(state.iterations(), 1);
+}
+BENCHMARK(BM_OcclusionPass)->Unit(benchmark::kMillisecond);
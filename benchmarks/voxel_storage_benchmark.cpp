@@ -0,0 +1,198 @@
+#include "chunk.h"
+#include "terrain_generator.h"
+#include <benchmark/benchmark.h>
+#include <algorithm>
+#include <array>
+#include <memory>
+#include <vector>
+
+// palette compressed chunk sections against the flat layout they replaced, a
+// std::vector<Voxel> of the whole chunk. The meshers read a flat MeshSnapshot
+// with either layout, so the layout only shows up when the snapshot is filled
+// in and when generation writes voxels (see mesher_benchmark for the meshers
+// themselves). The bytes counters are the actual sizes of both layouts holding
+// the same generated chunk
+
+namespace {
+
+static constexpr int CHUNK_VOLUME = CHUNK_WIDTH * CHUNK_DEPTH * CHUNK_HEIGHT;
+
+int get_flat_index(int x, int y, int z) {
+  return x + z * CHUNK_WIDTH + y * CHUNK_WIDTH * CHUNK_DEPTH;
+}
+
+// a generated chunk, its four neighbours and the same voxels laid out flat
+struct World {
+  // center, front, back, left, right
+  static constexpr ChunkPos POSITIONS[5] = {
+      {.x = 0, .z = 0},  {.x = 0, .z = 1}, {.x = 0, .z = -1},
+      {.x = -1, .z = 0}, {.x = 1, .z = 0},
+  };
+
+  TerrainGenerator terrain_generator{1234};
+  std::vector<std::unique_ptr<Chunk>> chunks;
+  std::vector<std::vector<Voxel>> flat_chunks;
+
+  World() {
+    for (auto pos : POSITIONS) {
+      auto chunk = std::make_unique<Chunk>(pos, terrain_generator);
+      chunk->mark_queued();
+      chunk->generate();
+
+      std::vector<Voxel> flat(CHUNK_VOLUME);
+      for (auto y = 0; y < CHUNK_HEIGHT; y++) {
+        const auto& voxels = chunk->get_section(y / SECTION_SIZE).voxels;
+        for (auto z = 0; z < CHUNK_DEPTH; z++) {
+          for (auto x = 0; x < CHUNK_WIDTH; x++) {
+            flat[get_flat_index(x, y, z)].voxel_type =
+                voxels.get(get_flat_index(x, y % SECTION_SIZE, z));
+          }
+        }
+      }
+      chunks.push_back(std::move(chunk));
+      flat_chunks.push_back(std::move(flat));
+    }
+  }
+};
+
+World& get_world() {
+  static World world;
+  return world;
+}
+
+void set_bytes_counter(benchmark::State& state, size_t bytes) {
+  state.counters["bytes"] = benchmark::Counter(
+      (double)bytes, benchmark::Counter::kDefaults,
+      benchmark::Counter::OneK::kIs1024);
+}
+
+} // namespace
+
+static void BM_ReadVoxelsPalette(benchmark::State& state) {
+  auto& chunk = *get_world().chunks[0];
+  for (auto _ : state) {
+    int solid = 0;
+    for (auto s = 0; s < SECTIONS_PER_CHUNK; s++) {
+      const auto& voxels = chunk.get_section(s).voxels;
+      for (auto i = 0; i < SECTION_VOLUME; i++) {
+        solid += voxels.get(i) != VoxelType::AIR;
+      }
+    }
+    benchmark::DoNotOptimize(solid);
+  }
+  state.SetItemsProcessed(state.iterations() * CHUNK_VOLUME);
+  set_bytes_counter(state, chunk.get_voxels_byte_size());
+}
+BENCHMARK(BM_ReadVoxelsPalette);
+
+static void BM_ReadVoxelsFlat(benchmark::State& state) {
+  const auto& flat = get_world().flat_chunks[0];
+  for (auto _ : state) {
+    int solid = 0;
+    for (auto i = 0; i < CHUNK_VOLUME; i++) {
+      solid += flat[i].voxel_type != VoxelType::AIR;
+    }
+    benchmark::DoNotOptimize(solid);
+  }
+  state.SetItemsProcessed(state.iterations() * CHUNK_VOLUME);
+  set_bytes_counter(state, flat.size() * sizeof(Voxel));
+}
+BENCHMARK(BM_ReadVoxelsFlat);
+
+// filling in a chunk the way generation does, then compacting it
+static void BM_WriteVoxelsPalette(benchmark::State& state) {
+  const auto& flat = get_world().flat_chunks[0];
+  for (auto _ : state) {
+    for (auto s = 0; s < SECTIONS_PER_CHUNK; s++) {
+      PaletteStorage<VoxelType> voxels(SECTION_VOLUME, VoxelType::AIR);
+      const Voxel* section = &flat[s * SECTION_VOLUME];
+      for (auto i = 0; i < SECTION_VOLUME; i++) {
+        voxels.set(i, section[i].voxel_type);
+      }
+      voxels.compact();
+      benchmark::DoNotOptimize(voxels);
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * CHUNK_VOLUME);
+}
+BENCHMARK(BM_WriteVoxelsPalette);
+
+static void BM_WriteVoxelsFlat(benchmark::State& state) {
+  const auto& flat = get_world().flat_chunks[0];
+  for (auto _ : state) {
+    std::vector<Voxel> voxels(CHUNK_VOLUME,
+                              Voxel{.voxel_type = VoxelType::AIR});
+    for (auto i = 0; i < CHUNK_VOLUME; i++) {
+      voxels[i] = flat[i];
+    }
+    benchmark::DoNotOptimize(voxels.data());
+  }
+  state.SetItemsProcessed(state.iterations() * CHUNK_VOLUME);
+}
+BENCHMARK(BM_WriteVoxelsFlat);
+
+// the part of meshing that reads the chunk's own storage
+static void BM_MeshSnapshotPalette(benchmark::State& state) {
+  auto& world = get_world();
+  auto& chunk = *world.chunks[0];
+  for (auto _ : state) {
+    chunk.request_mesh_creation(MeshingMode::GREEDY, *world.chunks[1],
+                                *world.chunks[2], *world.chunks[3],
+                                *world.chunks[4]);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_MeshSnapshotPalette);
+
+// the same padded snapshot filled in from flat chunks, rows y_begin - 1 to
+// y_end like Chunk::create_mesh_snapshot
+// NOTE: leaves out the occupancy columns, they are copied the same way with
+// either layout
+static void BM_MeshSnapshotFlat(benchmark::State& state) {
+  auto& world = get_world();
+  const auto& flat = world.flat_chunks;
+  auto& chunk = *world.chunks[0];
+  int first_section = SECTIONS_PER_CHUNK;
+  int last_section = -1;
+  for (auto s = 0; s < SECTIONS_PER_CHUNK; s++) {
+    if (!chunk.get_section(s).is_uniform(VoxelType::AIR)) {
+      first_section = std::min(first_section, s);
+      last_section = s;
+    }
+  }
+  int y_begin = first_section * SECTION_SIZE;
+  int y_end = (last_section + 1) * SECTION_SIZE;
+
+  for (auto _ : state) {
+    auto snapshot = std::make_unique<MeshSnapshot>();
+    snapshot->y_begin = y_begin;
+    snapshot->y_end = y_end;
+    snapshot->voxels.assign(MeshSnapshot::PADDED_AREA * (y_end - y_begin + 2),
+                            VoxelType::AIR);
+    for (auto y = std::max(y_begin - 1, 0);
+         y <= std::min(y_end, CHUNK_HEIGHT - 1); y++) {
+      VoxelType* row =
+          &snapshot->voxels[(y - y_begin + 1) * MeshSnapshot::PADDED_AREA];
+      for (auto z = 0; z < CHUNK_DEPTH; z++) {
+        for (auto x = 0; x < CHUNK_WIDTH; x++) {
+          row[MeshSnapshot::get_padded_column(x, z)] =
+              flat[0][get_flat_index(x, y, z)].voxel_type;
+        }
+      }
+      for (auto i = 0; i < CHUNK_WIDTH; i++) {
+        row[MeshSnapshot::get_padded_column(-1, i)] =
+            flat[3][get_flat_index(CHUNK_WIDTH - 1, y, i)].voxel_type;
+        row[MeshSnapshot::get_padded_column(CHUNK_WIDTH, i)] =
+            flat[4][get_flat_index(0, y, i)].voxel_type;
+        row[MeshSnapshot::get_padded_column(i, -1)] =
+            flat[1][get_flat_index(i, y, CHUNK_DEPTH - 1)].voxel_type;
+        row[MeshSnapshot::get_padded_column(i, CHUNK_DEPTH)] =
+            flat[2][get_flat_index(i, y, 0)].voxel_type;
+      }
+    }
+    benchmark::DoNotOptimize(snapshot.get());
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_MeshSnapshotFlat);
+
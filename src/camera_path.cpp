@@ -0,0 +1,48 @@
+#include "camera_path.h"
+#include "common.h"
+
+CameraPath load_camera_path(const std::string& path) {
+  std::ifstream file(path);
+  if (!file) {
+    PANIC("Cannot open camera path: {}\n", path);
+  }
+
+  CameraPath camera_path;
+  std::string header;
+  if (!(file >> header >> camera_path.seed) || header != "seed") {
+    PANIC("Camera path is missing its seed: {}\n", path);
+  }
+  CameraPose pose;
+  while (file >> pose.pos.x >> pose.pos.y >> pose.pos.z >> pose.yaw >>
+         pose.pitch) {
+    camera_path.poses.push_back(pose);
+  }
+  if (!file.eof()) {
+    PANIC("Malformed camera path: {}\n", path);
+  }
+  return camera_path;
+}
+
+CameraPose lerp_pose(const CameraPose& a, const CameraPose& b, float t) {
+  return CameraPose{.pos = a.pos + (b.pos - a.pos) * t,
+                    .yaw = a.yaw + (b.yaw - a.yaw) * t,
+                    .pitch = a.pitch + (b.pitch - a.pitch) * t};
+}
+
+CameraRecorder::CameraRecorder(const std::string& path, uint32_t seed)
+    : file(path) {
+  if (!file) {
+    PANIC("Cannot open camera path for writing: {}\n", path);
+  }
+  file << "seed " << seed << "\n";
+}
+
+void CameraRecorder::record(double time, const CameraPose& pose) {
+  if (time - last_record_time < RECORD_INTERVAL) {
+    return;
+  }
+  last_record_time = time;
+  // NOTE: flushed every pose, so closing the window any way keeps the path
+  file << pose.pos.x << " " << pose.pos.y << " " << pose.pos.z << " "
+       << pose.yaw << " " << pose.pitch << std::endl;
+}
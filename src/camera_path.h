@@ -0,0 +1,40 @@
+#pragma once
+#include <cstdint>
+#include <fstream>
+#include <glm/glm.hpp>
+#include <string>
+#include <vector>
+
+struct CameraPose {
+  glm::vec3 pos;
+  float yaw;
+  float pitch;
+};
+
+// a recorded camera flight through a world, replayed to measure culling.
+// Saved as text: a "seed <n>" line, then one "x y z yaw pitch" line per pose
+struct CameraPath {
+  uint32_t seed;
+  std::vector<CameraPose> poses;
+};
+
+// panics if the file can't be read or is malformed
+CameraPath load_camera_path(const std::string& path);
+
+// a pose t of the way from a to b
+CameraPose lerp_pose(const CameraPose& a, const CameraPose& b, float t);
+
+// appends a pose to the file every RECORD_INTERVAL seconds
+class CameraRecorder {
+public:
+  static constexpr double RECORD_INTERVAL = 0.25;
+
+private:
+  std::ofstream file;
+  double last_record_time = -RECORD_INTERVAL;
+
+public:
+  CameraRecorder(const std::string& path, uint32_t seed);
+
+  void record(double time, const CameraPose& pose);
+};
@@ -0,0 +1,148 @@
+#pragma once
+#include "chunk.h"
+#include "frustum.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+
+// finds the sections the camera could see through open voxels. Starting at the
+// camera's section, a breadth first search steps into neighbouring sections
+// that are in the frustum, only leaving a section through a face connected to
+// the face it was entered by (see ChunkSection::face_connectivity), and never
+// stepping back against a direction it already travelled in. Sections behind
+// solid ground (caves under the player, valleys behind a hill when
+// underground) are never reached.
+// NOTE: only needs face connectivity and the frustum, no gpu state
+class CaveCuller {
+private:
+  // a section queued by the search
+  struct Step {
+    int dx;
+    int dz;
+    int section;
+    // face it was entered through, or -1 for the camera's section
+    int entered;
+    // one bit per BlockFaces direction travelled to get here
+    int directions;
+  };
+
+  int radius;
+  int size;
+  ChunkPos center{.x = 0, .z = 0};
+  bool enabled = false;
+  std::vector<bool> reachable;
+  std::vector<Step> queue;
+
+  int get_index(int dx, int dz, int section) const {
+    return ((dx + radius) + (dz + radius) * size) * SECTIONS_PER_CHUNK +
+           section;
+  }
+
+public:
+  explicit CaveCuller(int radius)
+      : radius(radius), size(2 * radius + 1),
+        reachable(size * size * SECTIONS_PER_CHUNK) {
+  }
+
+  // get_connectivity(ChunkPos, section) returns the section's face
+  // connectivity, ALL_FACES_CONNECTED for chunks that aren't generated.
+  // Outside of the world's height everything counts as reachable
+  template <typename F>
+  void find_reachable(ChunkPos camera_chunk, float camera_y,
+                      const Frustum& frustum, F&& get_connectivity);
+
+  [[nodiscard]] bool is_reachable(ChunkPos w, int section) const {
+    int dx = w.x - center.x;
+    int dz = w.z - center.z;
+    if (!enabled) {
+      return true;
+    }
+    if (std::abs(dx) > radius || std::abs(dz) > radius) {
+      return false;
+    }
+    return reachable[get_index(dx, dz, section)];
+  }
+};
+
+template <typename F>
+void CaveCuller::find_reachable(ChunkPos camera_chunk, float camera_y,
+                                const Frustum& frustum, F&& get_connectivity) {
+  // chunk and section offsets of the section past each face, in world space
+  // NOTE: local z runs towards -z in world space, so the front neighbour is
+  // at z + 1
+  static constexpr int face_steps[6][3] = {
+      {0, -1, 0}, // BOTTOM
+      {0, 1, 0},  // TOP
+      {-1, 0, 0}, // LEFT
+      {1, 0, 0},  // RIGHT
+      {0, 0, -1}, // BACK
+      {0, 0, 1},  // FRONT
+  };
+
+  center = camera_chunk;
+  int camera_section = (int)std::floor(camera_y / SECTION_SIZE);
+  enabled = camera_section >= 0 && camera_section < SECTIONS_PER_CHUNK;
+  if (!enabled) {
+    return;
+  }
+
+  std::fill(reachable.begin(), reachable.end(), false);
+  queue.clear();
+  queue.push_back(Step{.dx = 0,
+                       .dz = 0,
+                       .section = camera_section,
+                       .entered = -1,
+                       .directions = 0});
+  reachable[get_index(0, 0, camera_section)] = true;
+
+  for (size_t head = 0; head < queue.size(); head++) {
+    auto step = queue[head];
+    auto w = ChunkPos{.x = center.x + step.dx, .z = center.z + step.dz};
+    uint16_t connectivity = get_connectivity(w, step.section);
+
+    for (auto face = 0; face < 6; face++) {
+      // faces come in opposite pairs: BOTTOM/TOP, LEFT/RIGHT, BACK/FRONT
+      int opposite = face ^ 1;
+      if ((step.directions >> opposite) & 1) {
+        continue;
+      }
+      if (step.entered != -1 && step.entered != face &&
+          !((connectivity >> get_face_pair_bit((BlockFaces)step.entered,
+                                               (BlockFaces)face)) &
+            1)) {
+        continue;
+      }
+
+      int dx = step.dx + face_steps[face][0];
+      int section = step.section + face_steps[face][1];
+      int dz = step.dz + face_steps[face][2];
+      if (std::abs(dx) > radius || std::abs(dz) > radius || section < 0 ||
+          section >= SECTIONS_PER_CHUNK) {
+        continue;
+      }
+      int index = get_index(dx, dz, section);
+      if (reachable[index]) {
+        continue;
+      }
+
+      int x_offset = (center.x + dx) * CHUNK_WIDTH;
+      int z_offset = (center.z + dz) * CHUNK_DEPTH;
+      auto bb = BoundingBox{
+          .min = glm::vec3(x_offset, section * SECTION_SIZE,
+                           z_offset - CHUNK_DEPTH),
+          .max = glm::vec3(x_offset + CHUNK_WIDTH,
+                           (section + 1) * SECTION_SIZE, z_offset)};
+      if (!frustum.test_bounding_box(bb)) {
+        continue;
+      }
+
+      reachable[index] = true;
+      queue.push_back(Step{.dx = dx,
+                           .dz = dz,
+                           .section = section,
+                           .entered = opposite,
+                           .directions = step.directions | (1 << face)});
+    }
+  }
+}
@@ -1,52 +1,152 @@
 #include "chunk.h"
 #include "common.h"
-#include "lerp_points.h"
+#include "terrain_generator.h"
 #include <algorithm>
+#include <bit>
 #include <cmath>
-#include <unordered_map>
 
-Chunk::Chunk(ChunkPos chunk_pos, siv::PerlinNoise& perlin_noise)
-    : chunk_pos(chunk_pos), perlin_noise(perlin_noise) {
+// NOTE: construction is cheap, voxels are only filled in by generate()
+Chunk::Chunk(ChunkPos chunk_pos, TerrainGenerator& terrain_generator)
+    : terrain_generator(terrain_generator), chunk_pos(chunk_pos) {
+}
+
+void Chunk::generate() {
+  auto expected = ChunkState::QUEUED;
+  if (!state.compare_exchange_strong(expected, ChunkState::GENERATING)) {
+    return;
+  }
+
   create_voxels();
-  bounding_box = BoundingBox{
-      .min = glm::vec3(get_x_offset(), 0, get_z_offset()),
-      .max = glm::vec3(get_x_offset(), CHUNK_HEIGHT, get_z_offset())};
+  for (auto i = 0; i < SECTIONS_PER_CHUNK; i++) {
+    // collapses all air/all stone sections down to a single value
+    sections[i].voxels.compact();
+    update_bounding_box(i);
+    update_face_connectivity(i);
+  }
+  state.store(ChunkState::GENERATED, std::memory_order_release);
+}
+
+// x and z always span the whole chunk (local z runs towards -z in world space),
+// y only the rows of the section holding a non air voxel, so eg: a section
+// with only a few tree tops in it doesn't get drawn when looking down past it
+void Chunk::update_bounding_box(int section) {
+  int shift = section % (64 / SECTION_SIZE) * SECTION_SIZE;
+  int word = section / (64 / SECTION_SIZE);
+  uint32_t rows = 0;
+  for (auto column = 0; column < CHUNK_WIDTH * CHUNK_DEPTH; column++) {
+    rows |= (occupancy[column * OCCUPANCY_WORDS + word] >> shift) & 0xffff;
+  }
+
+  // an empty section has no mesh, it just gets a flat box at its bottom
+  int y_min = section * SECTION_SIZE;
+  int y_max = y_min;
+  if (rows != 0) {
+    y_max = y_min + std::bit_width(rows);
+    y_min += std::countr_zero(rows);
+  }
+  sections[section].bounding_box = BoundingBox{
+      .min = glm::vec3(get_x_offset(), y_min, get_z_offset() - CHUNK_DEPTH),
+      .max = glm::vec3(get_x_offset() + CHUNK_WIDTH, y_max, get_z_offset())};
 }
 
-void Chunk::set_neighbour_chunks(Chunk* u_chunk, Chunk* d_chunk, Chunk* l_chunk,
-                                 Chunk* r_chunk) {
-  this->f_chunk = u_chunk;
-  this->b_chunk = d_chunk;
-  this->l_chunk = l_chunk;
-  this->r_chunk = r_chunk;
+void Chunk::request_mesh_creation(MeshingMode meshing_mode,
+                                  const Chunk& f_chunk, const Chunk& b_chunk,
+                                  const Chunk& l_chunk, const Chunk& r_chunk) {
+  this->meshing_mode = meshing_mode;
+  mesh_snapshot = create_mesh_snapshot(f_chunk, b_chunk, l_chunk, r_chunk);
+  mesh_uploaded = false;
+  state.store(ChunkState::MESHING, std::memory_order_release);
+}
+
+std::unique_ptr<MeshSnapshot> Chunk::create_mesh_snapshot(
+    const Chunk& f_chunk, const Chunk& b_chunk, const Chunk& l_chunk,
+    const Chunk& r_chunk) const {
+  auto snapshot = std::make_unique<MeshSnapshot>();
+
+  int first_section = SECTIONS_PER_CHUNK;
+  int last_section = -1;
+  for (auto i = 0; i < SECTIONS_PER_CHUNK; i++) {
+    snapshot->mesh_section[i] =
+        !sections[i].is_uniform(VoxelType::AIR) &&
+        !is_section_hidden(i, f_chunk, b_chunk, l_chunk, r_chunk);
+    if (snapshot->mesh_section[i]) {
+      first_section = std::min(first_section, i);
+      last_section = i;
+    }
+  }
+  if (last_section == -1) {
+    return snapshot;
+  }
+
+  snapshot->y_begin = first_section * SECTION_SIZE;
+  snapshot->y_end = (last_section + 1) * SECTION_SIZE;
+  int rows = snapshot->y_end - snapshot->y_begin + 2;
+  snapshot->voxels.assign(MeshSnapshot::PADDED_AREA * rows, VoxelType::AIR);
+
+  int y_min = std::max(snapshot->y_begin - 1, 0);
+  int y_max = std::min(snapshot->y_end, CHUNK_HEIGHT - 1);
+  for (auto y = y_min; y <= y_max; y++) {
+    VoxelType* row = &snapshot->voxels[(y - snapshot->y_begin + 1) *
+                                       MeshSnapshot::PADDED_AREA];
+    auto& voxels = sections[y / SECTION_SIZE].voxels;
+    for (auto z = 0; z < CHUNK_DEPTH; z++) {
+      VoxelType* padded = &row[MeshSnapshot::get_padded_column(0, z)];
+      if (voxels.is_uniform()) {
+        std::fill_n(padded, CHUNK_WIDTH, voxels.get(0));
+        continue;
+      }
+      for (auto x = 0; x < CHUNK_WIDTH; x++) {
+        padded[x] = voxels.get(get_section_index(x, y, z));
+      }
+    }
+
+    // one voxel border of each neighbour
+    for (auto i = 0; i < CHUNK_WIDTH; i++) {
+      row[MeshSnapshot::get_padded_column(-1, i)] =
+          l_chunk.get_voxel(CHUNK_WIDTH - 1, y, i).voxel_type;
+      row[MeshSnapshot::get_padded_column(CHUNK_WIDTH, i)] =
+          r_chunk.get_voxel(0, y, i).voxel_type;
+      row[MeshSnapshot::get_padded_column(i, -1)] =
+          f_chunk.get_voxel(i, y, CHUNK_DEPTH - 1).voxel_type;
+      row[MeshSnapshot::get_padded_column(i, CHUNK_DEPTH)] =
+          b_chunk.get_voxel(i, y, 0).voxel_type;
+    }
+  }
+
+  auto copy_column = [&](const Chunk& chunk, int x, int z, int padded_x,
+                         int padded_z) {
+    std::copy_n(&chunk.occupancy[get_column_index(x, z)], OCCUPANCY_WORDS,
+                &snapshot->occupancy[MeshSnapshot::get_padded_column(
+                                         padded_x, padded_z) *
+                                     OCCUPANCY_WORDS]);
+  };
+  for (auto z = 0; z < CHUNK_DEPTH; z++) {
+    for (auto x = 0; x < CHUNK_WIDTH; x++) {
+      copy_column(*this, x, z, x, z);
+    }
+  }
+  for (auto i = 0; i < CHUNK_WIDTH; i++) {
+    copy_column(l_chunk, CHUNK_WIDTH - 1, i, -1, i);
+    copy_column(r_chunk, 0, i, CHUNK_WIDTH, i);
+    copy_column(f_chunk, i, CHUNK_DEPTH - 1, i, -1);
+    copy_column(b_chunk, i, 0, i, CHUNK_DEPTH);
+  }
+  return snapshot;
 }
 
 // TODO: trees
 // mark locations for trees to be placed by chunk manager
 // (mark local x y, and world y coord)
+// NOTE: only depends on the world seed and chunk_pos, so a chunk regenerates
+// to exactly the same voxels
 void Chunk::create_voxels() {
-  voxels.resize(CHUNK_WIDTH * CHUNK_DEPTH * CHUNK_HEIGHT);
-  std::uniform_real_distribution<double> unif(0, 1);
-  std::random_device rand_dev;
-  std::mt19937 rand_engine(rand_dev());
-
-  LerpPoints lerp_points(Point(-1.0f, 60), Point(1.0f, 120));
-  lerp_points.add_point(Point(0.0, 90));
-  lerp_points.add_point(Point(0.2, 95));
-  lerp_points.add_point(Point(0.4, 90));
+  // noise for the whole chunk footprint is sampled in one batch
+  auto heights = terrain_generator.create_heightmap(chunk_pos);
 
   for (auto z = 0; z < CHUNK_DEPTH; z++) {
     for (auto x = 0; x < CHUNK_WIDTH; x++) {
       static constexpr int WATER_THRESHOLD = 90;
-      static constexpr float PERLIN_SCALE = 0.035f;
-      static constexpr float PERLIN_OCTAVES = 3;
-      static constexpr float PERLIN_PERSISTENCE = 0.5;
-
-      double perlin_value =
-          (perlin_noise.octave2D_11((get_x_offset() + x) * PERLIN_SCALE,
-                                    (get_z_offset() - z) * PERLIN_SCALE,
-                                    PERLIN_OCTAVES, PERLIN_PERSISTENCE));
-      int height = lerp_points.interpolate(perlin_value);
+      int height = heights[x + z * CHUNK_WIDTH];
 
       for (auto y = 0; y < std::max(height, WATER_THRESHOLD); y++) {
         /*
@@ -64,7 +164,8 @@ void Chunk::create_voxels() {
             set_voxel(x, y, z, VoxelType::DIRT);
           } else if (y >= height - 1) {
             set_voxel(x, y, z, VoxelType::GRASS);
-            if (unif(rand_engine) > 0.99) {
+            auto roll = terrain_generator.get_column_random(chunk_pos, x, z);
+            if (roll > 0.99) {
               structures.emplace_back(x, y + 1, z, StructureType::TREE);
             }
           } else if (y >= height - 5) {
@@ -78,290 +179,425 @@ void Chunk::create_voxels() {
       }
     }
   }
+
+  solid_height = *std::min_element(heights.begin(), heights.end());
 }
 
-// TODO: maybe unspagettify the mesh creation a little *sob*
-
-// TODO: use an enum here
-void Chunk::emit_vertex_coordinates(int index, float x, float y, float z) {
-  switch (index) {
-    case 0:
-      vertices_buffer.push_back(get_x_offset() + x);
-      vertices_buffer.push_back(y);
-      vertices_buffer.push_back(get_z_offset() - z);
-      break;
-    case 1:
-      vertices_buffer.push_back(get_x_offset() + x);
-      vertices_buffer.push_back(y);
-      vertices_buffer.push_back(get_z_offset() - z - 1.0f);
-      break;
-    case 2:
-      vertices_buffer.push_back(get_x_offset() + x + 1.0f);
-      vertices_buffer.push_back(y);
-      vertices_buffer.push_back(get_z_offset() - z - 1.0f);
-      break;
-    case 3:
-      vertices_buffer.push_back(get_x_offset() + x + 1.0f);
-      vertices_buffer.push_back(y);
-      vertices_buffer.push_back(get_z_offset() - z);
-      break;
-    case 4:
-      vertices_buffer.push_back(get_x_offset() + x);
-      vertices_buffer.push_back(y + 1.0f);
-      vertices_buffer.push_back(get_z_offset() - z);
-      break;
-    case 5:
-      vertices_buffer.push_back(get_x_offset() + x);
-      vertices_buffer.push_back(y + 1.0f);
-      vertices_buffer.push_back(get_z_offset() - z - 1.0f);
-      break;
-    case 6:
-      vertices_buffer.push_back(get_x_offset() + x + 1.0f);
-      vertices_buffer.push_back(y + 1.0f);
-      vertices_buffer.push_back(get_z_offset() - z - 1.0f);
-      break;
-    case 7:
-      vertices_buffer.push_back(get_x_offset() + x + 1.0f);
-      vertices_buffer.push_back(y + 1.0f);
-      vertices_buffer.push_back(get_z_offset() - z);
-      break;
-    default:
-      PANIC("what?\n");
-      break;
+// every group of non opaque voxels connects all the faces of the section it
+// touches with each other
+void Chunk::update_face_connectivity(int section) {
+  auto& s = sections[section];
+  s.connectivity_dirty = false;
+  if (s.voxels.is_uniform()) {
+    s.face_connectivity = is_opaque(s.voxels.get(0)) ? 0 : ALL_FACES_CONNECTED;
+    return;
+  }
+
+  // NOTE: open voxels are unmarked once visited
+  std::array<bool, SECTION_VOLUME> open;
+  for (auto i = 0; i < SECTION_VOLUME; i++) {
+    open[i] = !is_opaque(s.voxels.get(i));
+  }
+
+  // same indexing as get_section_index
+  static constexpr int X_STEP = 1;
+  static constexpr int Z_STEP = CHUNK_WIDTH;
+  static constexpr int Y_STEP = CHUNK_WIDTH * CHUNK_DEPTH;
+  std::array<uint16_t, SECTION_VOLUME> stack;
+  uint16_t connectivity = 0;
+  for (auto start = 0;
+       start < SECTION_VOLUME && connectivity != ALL_FACES_CONNECTED;
+       start++) {
+    if (!open[start]) {
+      continue;
+    }
+
+    int faces = 0;
+    int top = 0;
+    stack[top++] = start;
+    open[start] = false;
+    while (top > 0) {
+      int i = stack[--top];
+      int x = i % CHUNK_WIDTH;
+      int z = i / Z_STEP % CHUNK_DEPTH;
+      int y = i / Y_STEP;
+      auto visit = [&](bool inside, int next, BlockFaces face) {
+        if (!inside) {
+          faces |= 1 << (int)face;
+        } else if (open[next]) {
+          open[next] = false;
+          stack[top++] = next;
+        }
+      };
+      visit(x > 0, i - X_STEP, BlockFaces::LEFT);
+      visit(x < CHUNK_WIDTH - 1, i + X_STEP, BlockFaces::RIGHT);
+      visit(y > 0, i - Y_STEP, BlockFaces::BOTTOM);
+      visit(y < SECTION_SIZE - 1, i + Y_STEP, BlockFaces::TOP);
+      // local z runs from the front face to the back face
+      visit(z > 0, i - Z_STEP, BlockFaces::FRONT);
+      visit(z < CHUNK_DEPTH - 1, i + Z_STEP, BlockFaces::BACK);
+    }
+
+    for (auto a = 0; a < 6; a++) {
+      for (auto b = a + 1; b < 6; b++) {
+        if ((faces >> a) & (faces >> b) & 1) {
+          connectivity |= 1 << get_face_pair_bit((BlockFaces)a, (BlockFaces)b);
+        }
+      }
+    }
   }
+  s.face_connectivity = connectivity;
 }
 
-void Chunk::emit_texture_coordinates(TexturePosition position,
-                                     int atlas_index) {
-  static constexpr const int tex_atlas_rows = 16;
-  int column = atlas_index % tex_atlas_rows;
-  int row = atlas_index / tex_atlas_rows;
-  float xoff = (float)column / (float)tex_atlas_rows;
-  float yoff = (float)row / (float)tex_atlas_rows;
-
-  // NOTE: tex coords are upside down to account for uv coords starting at
-  // bottom left
-  switch (position) {
-    case TexturePosition::BOTTOM_LEFT:
-      vertices_buffer.push_back(0.f + xoff);
-      vertices_buffer.push_back(1.f / (float)tex_atlas_rows + yoff);
-      break;
-    case TexturePosition::BOTTOM_RIGHT:
-      vertices_buffer.push_back(1.f / (float)tex_atlas_rows + xoff);
-      vertices_buffer.push_back(1.f / (float)tex_atlas_rows + yoff);
-      break;
-    case TexturePosition::TOP_LEFT:
-      vertices_buffer.push_back(0.f + xoff);
-      vertices_buffer.push_back(0.f + yoff);
-      break;
-    case TexturePosition::TOP_RIGHT:
-      vertices_buffer.push_back(1.f / (float)tex_atlas_rows + xoff);
-      vertices_buffer.push_back(0.f + yoff);
-      break;
+// cube corners as local offsets:
+//      5------6
+//     /|     /|   y
+//    4------7 |   |  z
+//    | 1----|-2   | /
+//    |/     |/    |/
+//    0------3     o---- x
+static constexpr int cube_corners[8][3] = {
+    {0, 0, 0}, {0, 0, 1}, {1, 0, 1}, {1, 0, 0},
+    {0, 1, 0}, {0, 1, 1}, {1, 1, 1}, {1, 1, 0},
+};
+
+// per face: bottom left, bottom right, top right and top left corners as seen
+// in texture space, indexed by BlockFaces
+static constexpr int face_corners[6][4] = {
+    {1, 2, 3, 0}, // BOTTOM
+    {4, 7, 6, 5}, // TOP
+    {1, 0, 4, 5}, // LEFT
+    {3, 2, 6, 7}, // RIGHT
+    {2, 1, 5, 6}, // BACK
+    {0, 3, 7, 4}, // FRONT
+};
+
+// per face: the local axis (x = 0, y = 1, z = 2) that runs along the width
+// and height of the face, and the axis of the face normal
+static constexpr int face_axes[6][3] = {
+    {0, 2, 1}, // BOTTOM
+    {0, 2, 1}, // TOP
+    {2, 1, 0}, // LEFT
+    {2, 1, 0}, // RIGHT
+    {0, 1, 2}, // BACK
+    {0, 1, 2}, // FRONT
+};
+
+// emits a quad covering width x height voxel faces starting at local voxel
+// x, y, z. The shader derives texture coordinates from the local position, so
+// the texture repeats once per voxel across merged quads
+void Chunk::emit_quad(std::vector<PackedVertex>& vertices, BlockFaces face,
+                      int atlas_index, int x, int y, int z, int width,
+                      int height) {
+  int extent[3] = {1, 1, 1};
+  extent[face_axes[(int)face][0]] = width;
+  extent[face_axes[(int)face][1]] = height;
+
+  // bottom left, bottom right, top right, top left, the triangles come from
+  // QUAD_INDICES
+  for (auto i = 0; i < 4; i++) {
+    const int* corner = cube_corners[face_corners[(int)face][i]];
+    vertices.push_back(pack_vertex(
+        x + corner[0] * extent[0], y + corner[1] * extent[1],
+        z + corner[2] * extent[2], face, atlas_index));
   }
 }
 
-void Chunk::construct_face(BlockFaces face, int atlas_index, float x, float y,
-                           float z) {
-  switch ((BlockFaces)face) {
-    case BlockFaces::BOTTOM:
-      emit_vertex_coordinates(2, x, y, z);
-      emit_texture_coordinates(TexturePosition::BOTTOM_RIGHT, atlas_index);
-      emit_vertex_coordinates(3, x, y, z);
-      emit_texture_coordinates(TexturePosition::TOP_RIGHT, atlas_index);
-      emit_vertex_coordinates(0, x, y, z);
-      emit_texture_coordinates(TexturePosition::TOP_LEFT, atlas_index);
-
-      emit_vertex_coordinates(0, x, y, z);
-      emit_texture_coordinates(TexturePosition::TOP_LEFT, atlas_index);
-      emit_vertex_coordinates(1, x, y, z);
-      emit_texture_coordinates(TexturePosition::BOTTOM_LEFT, atlas_index);
-      emit_vertex_coordinates(2, x, y, z);
-      emit_texture_coordinates(TexturePosition::BOTTOM_RIGHT, atlas_index);
-      break;
-    case BlockFaces::TOP:
-      emit_vertex_coordinates(7, x, y, z);
-      emit_texture_coordinates(TexturePosition::BOTTOM_RIGHT, atlas_index);
-      emit_vertex_coordinates(6, x, y, z);
-      emit_texture_coordinates(TexturePosition::TOP_RIGHT, atlas_index);
-      emit_vertex_coordinates(5, x, y, z);
-      emit_texture_coordinates(TexturePosition::TOP_LEFT, atlas_index);
-
-      emit_vertex_coordinates(5, x, y, z);
-      emit_texture_coordinates(TexturePosition::TOP_LEFT, atlas_index);
-      emit_vertex_coordinates(4, x, y, z);
-      emit_texture_coordinates(TexturePosition::BOTTOM_LEFT, atlas_index);
-      emit_vertex_coordinates(7, x, y, z);
-      emit_texture_coordinates(TexturePosition::BOTTOM_RIGHT, atlas_index);
-      break;
-    case BlockFaces::LEFT:
-      emit_vertex_coordinates(0, x, y, z);
-      emit_texture_coordinates(TexturePosition::BOTTOM_RIGHT, atlas_index);
-      emit_vertex_coordinates(4, x, y, z);
-      emit_texture_coordinates(TexturePosition::TOP_RIGHT, atlas_index);
-      emit_vertex_coordinates(5, x, y, z);
-      emit_texture_coordinates(TexturePosition::TOP_LEFT, atlas_index);
-
-      emit_vertex_coordinates(5, x, y, z);
-      emit_texture_coordinates(TexturePosition::TOP_LEFT, atlas_index);
-      emit_vertex_coordinates(1, x, y, z);
-      emit_texture_coordinates(TexturePosition::BOTTOM_LEFT, atlas_index);
-      emit_vertex_coordinates(0, x, y, z);
-      emit_texture_coordinates(TexturePosition::BOTTOM_RIGHT, atlas_index);
-      break;
-    case BlockFaces::RIGHT:
-      emit_vertex_coordinates(2, x, y, z);
-      emit_texture_coordinates(TexturePosition::BOTTOM_RIGHT, atlas_index);
-      emit_vertex_coordinates(6, x, y, z);
-      emit_texture_coordinates(TexturePosition::TOP_RIGHT, atlas_index);
-      emit_vertex_coordinates(7, x, y, z);
-      emit_texture_coordinates(TexturePosition::TOP_LEFT, atlas_index);
-
-      emit_vertex_coordinates(7, x, y, z);
-      emit_texture_coordinates(TexturePosition::TOP_LEFT, atlas_index);
-      emit_vertex_coordinates(3, x, y, z);
-      emit_texture_coordinates(TexturePosition::BOTTOM_LEFT, atlas_index);
-      emit_vertex_coordinates(2, x, y, z);
-      emit_texture_coordinates(TexturePosition::BOTTOM_RIGHT, atlas_index);
-      break;
-    case BlockFaces::FRONT:
-      emit_vertex_coordinates(3, x, y, z);
-      emit_texture_coordinates(TexturePosition::BOTTOM_RIGHT, atlas_index);
-      emit_vertex_coordinates(7, x, y, z);
-      emit_texture_coordinates(TexturePosition::TOP_RIGHT, atlas_index);
-      emit_vertex_coordinates(4, x, y, z);
-      emit_texture_coordinates(TexturePosition::TOP_LEFT, atlas_index);
-
-      emit_vertex_coordinates(4, x, y, z);
-      emit_texture_coordinates(TexturePosition::TOP_LEFT, atlas_index);
-      emit_vertex_coordinates(0, x, y, z);
-      emit_texture_coordinates(TexturePosition::BOTTOM_LEFT, atlas_index);
-      emit_vertex_coordinates(3, x, y, z);
-      emit_texture_coordinates(TexturePosition::BOTTOM_RIGHT, atlas_index);
-      break;
-    case BlockFaces::BACK:
-      emit_vertex_coordinates(1, x, y, z);
-      emit_texture_coordinates(TexturePosition::BOTTOM_RIGHT, atlas_index);
-      emit_vertex_coordinates(5, x, y, z);
-      emit_texture_coordinates(TexturePosition::TOP_RIGHT, atlas_index);
-      emit_vertex_coordinates(6, x, y, z);
-      emit_texture_coordinates(TexturePosition::TOP_LEFT, atlas_index);
-
-      emit_vertex_coordinates(6, x, y, z);
-      emit_texture_coordinates(TexturePosition::TOP_LEFT, atlas_index);
-      emit_vertex_coordinates(2, x, y, z);
-      emit_texture_coordinates(TexturePosition::BOTTOM_LEFT, atlas_index);
-      emit_vertex_coordinates(1, x, y, z);
-      emit_texture_coordinates(TexturePosition::BOTTOM_RIGHT, atlas_index);
-      break;
+// per face: the offset to the voxel the face borders, a face is visible if
+// that voxel is air
+// NOTE: front faces the player (local -z), back faces away (d'oh)
+static constexpr int face_normals[6][3] = {
+    {0, -1, 0}, // BOTTOM
+    {0, 1, 0},  // TOP
+    {-1, 0, 0}, // LEFT
+    {1, 0, 0},  // RIGHT
+    {0, 0, 1},  // BACK
+    {0, 0, -1}, // FRONT
+};
+
+// uniform solid sections surrounded by uniform solid sections can't have a
+// visible face
+bool Chunk::is_section_hidden(int section, const Chunk& f_chunk,
+                              const Chunk& b_chunk, const Chunk& l_chunk,
+                              const Chunk& r_chunk) const {
+  if (!sections[section].is_uniform_solid()) {
+    return false;
+  }
+  // NOTE: the bottom faces of the world and top faces of the sky are always
+  // meshed
+  if (section == 0 || section == SECTIONS_PER_CHUNK - 1) {
+    return false;
   }
+  return sections[section - 1].is_uniform_solid() &&
+         sections[section + 1].is_uniform_solid() &&
+         l_chunk.sections[section].is_uniform_solid() &&
+         r_chunk.sections[section].is_uniform_solid() &&
+         f_chunk.sections[section].is_uniform_solid() &&
+         b_chunk.sections[section].is_uniform_solid();
 }
 
 void Chunk::create_mesh() {
+  if (build_mesh()) {
+    finish_mesh();
+  }
+}
 
-  // algorithm:
-  //  for each voxel that isn't an air type, check if any of it's six faces
-  //  borders an air block, if so add that face to the mesh, else ignore
-  if (mesh_created == true) {
+bool Chunk::build_mesh() {
+  if (get_state() != ChunkState::MESHING) {
     // PRINT("Threading is hard...\n");
-    return;
+    return false;
   }
-  mesh_created = true;
 
-  for (auto y = 0; y < CHUNK_HEIGHT; y++) {
+  // NOTE: freed once meshing is done
+  auto snapshot = std::move(mesh_snapshot);
+  for (auto i = 0; i < SECTIONS_PER_CHUNK; i++) {
+    sections[i].vertices_buffer.clear();
+    if (!snapshot->mesh_section[i]) {
+      continue;
+    }
+
+    switch (meshing_mode) {
+      case MeshingMode::NAIVE:
+        create_naive_mesh(i, *snapshot);
+        break;
+      case MeshingMode::GREEDY:
+        create_greedy_mesh(i, *snapshot);
+        break;
+      case MeshingMode::BINARY:
+        create_binary_mesh(i, *snapshot);
+        break;
+    }
+  }
+
+  return true;
+}
+
+// NOTE: only flag the mesh as ready once it is complete (and staged), otherwise
+// the render thread can upload a half built vertex buffer
+void Chunk::finish_mesh() {
+  state.store(ChunkState::READY, std::memory_order_release);
+}
+
+void Chunk::create_naive_mesh(int section, const MeshSnapshot& snapshot) {
+  // algorithm:
+  //  for each voxel that isn't an air type, check if any of it's six faces
+  //  borders an air block, if so add that face to the mesh, else ignore
+  auto& vertices = sections[section].vertices_buffer;
+  for (auto y = section * SECTION_SIZE; y < (section + 1) * SECTION_SIZE;
+       y++) {
     for (auto z = 0; z < CHUNK_DEPTH; z++) {
       for (auto x = 0; x < CHUNK_WIDTH; x++) {
-        // check if current voxel isn't an air block
-        auto voxel_type = get_voxel(x, y, z).voxel_type;
+        auto voxel_type = snapshot.get(x, y, z);
         if (voxel_type == VoxelType::AIR) {
           continue;
         }
 
-        std::unordered_map<BlockFaces, int> tex_atlas_map =
-            block_to_faces_map[voxel_type];
-
         for (auto face = (int)BlockFaces::BOTTOM; face < 6; face++) {
-          switch ((BlockFaces)face) {
-            case BlockFaces::BOTTOM: {
-              int tex_atlas_index = tex_atlas_map[(BlockFaces)face];
-              if (y == 0) {
-                construct_face(BlockFaces::BOTTOM, tex_atlas_index, x, y, z);
-                continue;
-              }
-              if (is_air_voxel(x, y - 1, z)) {
-                construct_face(BlockFaces::BOTTOM, tex_atlas_index, x, y, z);
-              }
-              break;
-            }
-            case BlockFaces::TOP: {
-              int tex_atlas_index = tex_atlas_map[(BlockFaces)face];
-              if (y == CHUNK_HEIGHT - 1) {
-                construct_face(BlockFaces::TOP, tex_atlas_index, x, y, z);
-                continue;
-              }
-              if (is_air_voxel(x, y + 1, z)) {
-                construct_face(BlockFaces::TOP, tex_atlas_index, x, y, z);
+          const int* normal = face_normals[face];
+          if (snapshot.is_air(x + normal[0], y + normal[1], z + normal[2])) {
+            emit_quad(vertices, (BlockFaces)face,
+                      get_atlas_index(voxel_type, (BlockFaces)face), x, y, z,
+                      1, 1);
+          }
+        }
+      }
+    }
+  }
+}
+
+void Chunk::create_greedy_mesh(int section, const MeshSnapshot& snapshot) {
+  // algorithm:
+  //  for each face direction, sweep the section one slice at a time along the
+  //  face normal. Visible faces in the slice are written to a 2d mask keyed by
+  //  atlas index, then merged into the widest, then tallest, rectangles of
+  //  matching faces
+  static constexpr int dimensions[3] = {CHUNK_WIDTH, SECTION_SIZE, CHUNK_DEPTH};
+  const int y_offset = section * SECTION_SIZE;
+  auto& vertices = sections[section].vertices_buffer;
+  std::vector<int> mask;
+
+  for (auto face = (int)BlockFaces::BOTTOM; face < 6; face++) {
+    const int u_axis = face_axes[face][0];
+    const int v_axis = face_axes[face][1];
+    const int n_axis = face_axes[face][2];
+    const int u_size = dimensions[u_axis];
+    const int v_size = dimensions[v_axis];
+    const int* normal = face_normals[face];
+    mask.assign(u_size * v_size, 0);
+
+    for (auto n = 0; n < dimensions[n_axis]; n++) {
+      // 0 = no face, otherwise atlas index + 1
+      for (auto v = 0; v < v_size; v++) {
+        for (auto u = 0; u < u_size; u++) {
+          int pos[3];
+          pos[u_axis] = u;
+          pos[v_axis] = v;
+          pos[n_axis] = n;
+          pos[1] += y_offset;
+
+          auto voxel_type = snapshot.get(pos[0], pos[1], pos[2]);
+          if (voxel_type == VoxelType::AIR ||
+              !snapshot.is_air(pos[0] + normal[0], pos[1] + normal[1],
+                               pos[2] + normal[2])) {
+            mask[u + v * u_size] = 0;
+            continue;
+          }
+          mask[u + v * u_size] =
+              get_atlas_index(voxel_type, (BlockFaces)face) + 1;
+        }
+      }
+
+      for (auto v = 0; v < v_size; v++) {
+        for (auto u = 0; u < u_size;) {
+          int key = mask[u + v * u_size];
+          if (key == 0) {
+            u++;
+            continue;
+          }
+
+          int width = 1;
+          while (u + width < u_size && mask[u + width + v * u_size] == key) {
+            width++;
+          }
+
+          int height = 1;
+          while (v + height < v_size) {
+            bool row_matches = true;
+            for (auto i = 0; i < width; i++) {
+              if (mask[u + i + (v + height) * u_size] != key) {
+                row_matches = false;
+                break;
               }
-              break;
             }
-            case BlockFaces::LEFT: {
-              int tex_atlas_index = tex_atlas_map[(BlockFaces)face];
-              if (x == 0) {
-                if (!(l_chunk->is_air_voxel(CHUNK_WIDTH - 1, y, z))) {
-                  continue;
-                }
-                construct_face(BlockFaces::LEFT, tex_atlas_index, x, y, z);
-                continue;
-              }
-              if (is_air_voxel(x - 1, y, z)) {
-                construct_face(BlockFaces::LEFT, tex_atlas_index, x, y, z);
-              }
+            if (!row_matches) {
               break;
             }
-            case BlockFaces::RIGHT: {
-              int tex_atlas_index = tex_atlas_map[(BlockFaces)face];
-              if (x == CHUNK_WIDTH - 1) {
-                if (!(r_chunk->is_air_voxel(0, y, z))) {
-                  continue;
-                }
-                construct_face(BlockFaces::RIGHT, tex_atlas_index, x, y, z);
-                continue;
-              }
-              if (is_air_voxel(x + 1, y, z)) {
-                construct_face(BlockFaces::RIGHT, tex_atlas_index, x, y, z);
-              }
-              break;
+            height++;
+          }
+
+          for (auto j = 0; j < height; j++) {
+            for (auto i = 0; i < width; i++) {
+              mask[u + i + (v + j) * u_size] = 0;
             }
-            case BlockFaces::FRONT: {
-              // NOTE: front faces the player, back faces away (d'oh)
-              int tex_atlas_index = tex_atlas_map[(BlockFaces)face];
-              if (z == 0) {
-                if (!(f_chunk->is_air_voxel(x, y, CHUNK_DEPTH - 1))) {
-                  continue;
-                }
-                construct_face(BlockFaces::FRONT, tex_atlas_index, x, y, z);
-                continue;
-              }
-              if (is_air_voxel(x, y, z - 1)) {
-                construct_face(BlockFaces::FRONT, tex_atlas_index, x, y, z);
+          }
+
+          int pos[3];
+          pos[u_axis] = u;
+          pos[v_axis] = v;
+          pos[n_axis] = n;
+          emit_quad(vertices, (BlockFaces)face, key - 1, pos[0],
+                    pos[1] + y_offset, pos[2], width, height);
+          u += width;
+        }
+      }
+    }
+  }
+}
+
+void Chunk::create_binary_mesh(int section, const MeshSnapshot& snapshot) {
+  // algorithm:
+  //  every column of the section is a 16 bit occupancy mask over y. A face is
+  //  visible where a voxel is occupied and its neighbour in the face direction
+  //  isn't, so each face direction is a shift and an and-not per column. The
+  //  visible faces are scattered into one 16x16 bit plane per slice (same
+  //  axes as the greedy mesher), and rectangles of faces sharing a texture
+  //  are then merged using ctz and masks over whole rows
+  const int y_offset = section * SECTION_SIZE;
+  auto& vertices = sections[section].vertices_buffer;
+
+  // [face][slice along the normal][v] -> bits over u
+  uint16_t planes[6][SECTION_SIZE][SECTION_SIZE] = {};
+  for (auto z = 0; z < CHUNK_DEPTH; z++) {
+    for (auto x = 0; x < CHUNK_WIDTH; x++) {
+      uint32_t column = snapshot.get_section_occupancy(x, z, section);
+      if (column == 0) {
+        continue;
+      }
+
+      // NOTE: the snapshot's padding covers the neighbouring chunks and the
+      // voxels just below and above the section (air outside the world)
+      uint32_t below = !snapshot.is_air(x, y_offset - 1, z);
+      uint32_t above = !snapshot.is_air(x, y_offset + SECTION_SIZE, z);
+      uint32_t left = snapshot.get_section_occupancy(x - 1, z, section);
+      uint32_t right = snapshot.get_section_occupancy(x + 1, z, section);
+      uint32_t front = snapshot.get_section_occupancy(x, z - 1, section);
+      uint32_t back = snapshot.get_section_occupancy(x, z + 1, section);
+
+      // indexed by BlockFaces
+      const uint32_t visible_faces[6] = {
+          column & ~(column << 1 | below),
+          column & ~(column >> 1 | above << (SECTION_SIZE - 1)),
+          column & ~left,
+          column & ~right,
+          column & ~back,
+          column & ~front,
+      };
+
+      for (auto face = (int)BlockFaces::BOTTOM; face < 6; face++) {
+        for (uint32_t faces = visible_faces[face]; faces != 0;
+             faces &= faces - 1) {
+          int pos[3] = {x, std::countr_zero(faces), z};
+          planes[face][pos[face_axes[face][2]]][pos[face_axes[face][1]]] |=
+              1 << pos[face_axes[face][0]];
+        }
+      }
+    }
+  }
+
+  for (auto face = (int)BlockFaces::BOTTOM; face < 6; face++) {
+    const int u_axis = face_axes[face][0];
+    const int v_axis = face_axes[face][1];
+    const int n_axis = face_axes[face][2];
+
+    auto get_atlas = [&](int u, int v, int n) {
+      int pos[3];
+      pos[u_axis] = u;
+      pos[v_axis] = v;
+      pos[n_axis] = n;
+      return get_atlas_index(snapshot.get(pos[0], pos[1] + y_offset, pos[2]),
+                             (BlockFaces)face);
+    };
+
+    for (auto n = 0; n < SECTION_SIZE; n++) {
+      auto& plane = planes[face][n];
+      for (auto v = 0; v < SECTION_SIZE; v++) {
+        while (plane[v] != 0) {
+          int u = std::countr_zero(plane[v]);
+          int atlas_index = get_atlas(u, v, n);
+
+          int run = std::countr_one((uint32_t)plane[v] >> u);
+          int width = 1;
+          while (width < run && get_atlas(u + width, v, n) == atlas_index) {
+            width++;
+          }
+          const uint16_t row_mask = ((1u << width) - 1) << u;
+
+          int height = 1;
+          while (v + height < SECTION_SIZE &&
+                 (plane[v + height] & row_mask) == row_mask) {
+            bool row_matches = true;
+            for (auto i = 0; i < width; i++) {
+              if (get_atlas(u + i, v + height, n) != atlas_index) {
+                row_matches = false;
+                break;
               }
-              break;
             }
-            case BlockFaces::BACK: {
-              int tex_atlas_index = tex_atlas_map[(BlockFaces)face];
-              if (z == CHUNK_DEPTH - 1) {
-                if (!(b_chunk->is_air_voxel(x, y, 0))) {
-                  continue;
-                }
-                construct_face(BlockFaces::BACK, tex_atlas_index, x, y, z);
-                continue;
-              }
-              if (is_air_voxel(x, y, z + 1)) {
-                construct_face(BlockFaces::BACK, tex_atlas_index, x, y, z);
-              }
+            if (!row_matches) {
               break;
             }
+            height++;
+          }
+
+          for (auto j = 0; j < height; j++) {
+            plane[v + j] &= ~row_mask;
           }
+
+          int pos[3];
+          pos[u_axis] = u;
+          pos[v_axis] = v;
+          pos[n_axis] = n;
+          emit_quad(vertices, (BlockFaces)face, atlas_index, pos[0],
+                    pos[1] + y_offset, pos[2], width, height);
         }
       }
     }
@@ -1,18 +1,44 @@
 #pragma once
-#include "PerlinNoise.hpp"
+#include "gpu_allocator.h"
+#include "palette_storage.h"
 #include "shader_program.h"
+#include "staging_allocator.h"
 #include <glad/glad.h>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
-#include <unordered_map>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <utility>
 #include <vector>
 
 static constexpr int CHUNK_WIDTH = 16;
 static constexpr int CHUNK_DEPTH = 16;
 static constexpr int CHUNK_HEIGHT = 256;
-
-enum class VoxelType {
+static constexpr int SECTION_SIZE = 16;
+static constexpr int SECTION_VOLUME = CHUNK_WIDTH * CHUNK_DEPTH * SECTION_SIZE;
+static constexpr int SECTIONS_PER_CHUNK = CHUNK_HEIGHT / SECTION_SIZE;
+// 64 bit words of occupancy per column, see Chunk::occupancy
+static constexpr int OCCUPANCY_WORDS = CHUNK_HEIGHT / 64;
+// packed vertex layout (32 bits, low to high):
+//  x: 5 | y: 9 | z: 5 | face: 3 | atlas index: 8
+// positions are local to the chunk, the chunk origin is added in the shader
+using PackedVertex = uint32_t;
+// meshes are lists of quads, 4 vertices each (bottom left, bottom right, top
+// right, top left). They are all drawn with one shared index buffer repeating
+// this pattern, offset by 4 per quad
+static constexpr int QUAD_INDICES[6] = {1, 2, 3, 3, 0, 1};
+// a 3d checkerboard exposes the most faces a section can have, so a section's
+// mesh always fits 16 bit indices
+static constexpr int MAX_QUADS_PER_SECTION = SECTION_VOLUME / 2 * 6;
+static_assert(MAX_QUADS_PER_SECTION * 4 <= 65536);
+
+enum class VoxelType : uint8_t {
   AIR,
   DIRT,
   GRASS,
@@ -22,6 +48,12 @@ enum class VoxelType {
   LEAF,
 };
 
+// whether a voxel blocks the view. Water and leaves can be seen through
+constexpr bool is_opaque(VoxelType voxel_type) {
+  return voxel_type != VoxelType::AIR && voxel_type != VoxelType::WATER &&
+         voxel_type != VoxelType::LEAF;
+}
+
 enum class StructureType {
   TREE,
 };
@@ -46,13 +78,61 @@ enum class BlockFaces {
   FRONT,
 };
 
-enum class TexturePosition {
-  BOTTOM_LEFT,
-  BOTTOM_RIGHT,
-  TOP_LEFT,
-  TOP_RIGHT,
+// bit of an unordered pair of distinct faces in a section's face connectivity,
+// there are 15 of them
+constexpr int get_face_pair_bit(BlockFaces a, BlockFaces b) {
+  int i = std::min((int)a, (int)b);
+  int j = std::max((int)a, (int)b);
+  return i * (11 - i) / 2 + (j - i - 1);
+}
+
+static constexpr uint16_t ALL_FACES_CONNECTED = (1 << 15) - 1;
+
+// chunks only ever move forward through these states (apart from READY going
+// back to MESHING for a remesh). The render thread only touches a chunk's
+// voxels once it is at least GENERATED
+enum class ChunkState {
+  PENDING,    // in the render thread's load order, can still be dropped
+  QUEUED,     // waiting for a generation worker
+  GENERATING, // voxels being filled in on a worker
+  GENERATED,  // voxels done, waiting on neighbours before it can be meshed
+  MESHING,    // queued for or being meshed on the mesh thread
+  READY,      // mesh complete, uploaded by the render thread
+};
+
+// atlas index of every face of a voxel type, indexed by [VoxelType][BlockFaces]
+// (BOTTOM, TOP, LEFT, RIGHT, BACK, FRONT).
+// NOTE: air is never meshed and leaves don't have a texture yet
+// clang-format off
+static constexpr std::array<std::array<uint8_t, 6>, 7> BLOCK_FACE_ATLAS = {{
+  /* AIR   */ {0, 0, 0, 0, 0, 0},
+  /* DIRT  */ {2, 2, 2, 2, 2, 2},
+  /* GRASS */ {2, 0, 3, 3, 3, 3},
+  /* STONE */ {1, 1, 1, 1, 1, 1},
+  /* WATER */ {192 + 13, 192 + 13, 192 + 13, 192 + 13, 192 + 13, 192 + 13},
+  /* WOOD  */ {20, 20, 20, 20, 20, 20},
+  /* LEAF  */ {0, 0, 0, 0, 0, 0},
+}};
+// clang-format on
+
+enum class MeshingMode {
+  NAIVE,  // one quad per exposed voxel face
+  GREEDY, // coplanar faces sharing a texture merged into larger quads
+  BINARY, // same quads as greedy, found with occupancy bitmasks
 };
 
+constexpr const char* get_meshing_mode_name(MeshingMode meshing_mode) {
+  switch (meshing_mode) {
+    case MeshingMode::NAIVE:
+      return "naive";
+    case MeshingMode::GREEDY:
+      return "greedy";
+    case MeshingMode::BINARY:
+      return "binary";
+  }
+  return "";
+}
+
 struct Voxel {
   VoxelType voxel_type;
 };
@@ -66,182 +146,396 @@ struct ChunkPos {
   }
 };
 
+// splitmix64 finalizer, every input bit affects every output bit
+inline uint64_t mix_bits(uint64_t h) {
+  h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9;
+  h = (h ^ (h >> 27)) * 0x94d049bb133111eb;
+  return h ^ (h >> 31);
+}
+
+inline uint64_t pack_chunk_pos(ChunkPos c) {
+  return (uint64_t)(uint32_t)c.x << 32 | (uint32_t)c.z;
+}
+
 namespace std {
 template <>
 struct hash<ChunkPos> {
+  // NOTE: hash(x) ^ hash(z) collides for every x == z, so both coords are
+  // packed into 64 bits and mixed instead
   size_t operator()(const ChunkPos& c) const {
-    return (hash<int>()(c.x)) ^ (hash<int>()(c.z));
+    return mix_bits(pack_chunk_pos(c));
   }
 };
 } // namespace std
 
+// world space, spans whole voxels
 struct BoundingBox {
   glm::vec3 min;
   glm::vec3 max;
 };
 
+// a 16^3 slice of a chunk column, stored, meshed and culled on its own.
+// Sections made of a single voxel type (eg: all air, all stone) keep no per
+// voxel data, all air ones are skipped by the mesher entirely
+struct ChunkSection {
+  PaletteStorage<VoxelType> voxels{SECTION_VOLUME, VoxelType::AIR};
+  std::vector<PackedVertex> vertices_buffer;
+  BoundingBox bounding_box;
+
+  // range of the shared vbo holding this section's mesh, set once the mesh has
+  // been uploaded. The cpu side copy of the vertices is dropped as soon as the
+  // mesher has staged it. A previous upload stays drawable while the chunk is
+  // being remeshed
+  std::optional<GpuAllocation> gpu_allocation;
+  int gpu_vertex_count = 0;
+  // vertices of the section in the chunk's staged mesh
+  int staged_vertex_count = 0;
+  // the section's slot in ChunkManager's draw list, -1 while it isn't drawn,
+  // and the last frame it was in the render list. Render thread only
+  int draw_slot = -1;
+  int64_t drawn_frame = -1;
+
+  // a bit per pair of faces (see get_face_pair_bit) that can see each other
+  // through non opaque voxels inside the section. Refreshed lazily after edits,
+  // see Chunk::get_face_connectivity
+  uint16_t face_connectivity = ALL_FACES_CONNECTED;
+  bool connectivity_dirty = false;
+
+  [[nodiscard]] bool is_uniform(VoxelType voxel_type) const {
+    return voxels.is_uniform() && voxels.get(0) == voxel_type;
+  }
+
+  [[nodiscard]] bool is_uniform_solid() const {
+    return voxels.is_uniform() && voxels.get(0) != VoxelType::AIR;
+  }
+};
+
+// immutable copy of everything meshing a chunk reads: its voxels plus a one
+// voxel border of each neighbour, padded to 18 x rows x 18 so the mesher never
+// needs a boundary check. Only the rows spanning the sections to be meshed
+// (plus one above and below) are kept, rows past the top or bottom of the
+// world are air.
+// NOTE: taken by the render thread, which is the only thread writing voxels
+// outside of generation, so meshers never read another chunk's live data
+struct MeshSnapshot {
+  static constexpr int PADDED_WIDTH = CHUNK_WIDTH + 2;
+  static constexpr int PADDED_DEPTH = CHUNK_DEPTH + 2;
+  static constexpr int PADDED_AREA = PADDED_WIDTH * PADDED_DEPTH;
+
+  // sections that aren't all air or hidden
+  std::array<bool, SECTIONS_PER_CHUNK> mesh_section{};
+  // rows y_begin - 1 to y_end (inclusive) are stored
+  int y_begin = 0;
+  int y_end = 0;
+  std::vector<VoxelType> voxels;
+  // same layout as Chunk::occupancy, over the padded columns
+  std::array<uint64_t, PADDED_AREA * OCCUPANCY_WORDS> occupancy{};
+
+  // x and z from -1 to 16
+  static int get_padded_column(int x, int z) {
+    return (x + 1) + (z + 1) * PADDED_WIDTH;
+  }
+
+  VoxelType get(int x, int y, int z) const {
+    return voxels[get_padded_column(x, z) + (y - y_begin + 1) * PADDED_AREA];
+  }
+
+  bool is_air(int x, int y, int z) const {
+    return get(x, y, z) == VoxelType::AIR;
+  }
+
+  uint32_t get_section_occupancy(int x, int z, int section) const {
+    static constexpr int SECTIONS_PER_WORD = 64 / SECTION_SIZE;
+    uint64_t word = occupancy[get_padded_column(x, z) * OCCUPANCY_WORDS +
+                              section / SECTIONS_PER_WORD];
+    return (word >> (section % SECTIONS_PER_WORD * SECTION_SIZE)) & 0xffff;
+  }
+};
+
+class TerrainGenerator;
+
 // NOTE: uses LH coordinate system for storage of local voxel positions
 class Chunk {
 private:
-  Chunk* f_chunk;
-  Chunk* b_chunk;
-  Chunk* l_chunk;
-  Chunk* r_chunk;
-  siv::PerlinNoise& perlin_noise;
-
-  std::vector<Voxel> voxels;
-  std::vector<float> vertices_buffer;
-  std::vector<float> water_vertices_buffer;
+  TerrainGenerator& terrain_generator;
+
+  std::array<ChunkSection, SECTIONS_PER_CHUNK> sections;
+  // one bit per voxel, set for anything that isn't air. Each (x, z) column is
+  // OCCUPANCY_WORDS words with bit y % 64 of word y / 64 for voxel y, kept up
+  // to date by set_voxel
+  std::array<uint64_t, CHUNK_WIDTH * CHUNK_DEPTH * OCCUPANCY_WORDS> occupancy{};
   std::vector<WorldStructure> structures;
-  BoundingBox bounding_box;
+  // set by request_mesh_creation, consumed (and freed) by create_mesh
+  std::unique_ptr<MeshSnapshot> mesh_snapshot;
+  // the latest mesh, written into the staging ring by the mesher (every
+  // section's vertices back to back) and waiting to be copied into the vbo.
+  // Owned by the mesher while MESHING, by the render thread after
+  std::optional<StagingRange> staged_mesh;
 
   ChunkPos chunk_pos;
-  bool mesh_created = false;
-  bool mesh_creation_requested = false;
-
-  void emit_vertex_coordinates(int index, float x, float y, float z);
-  void emit_texture_coordinates(TexturePosition position, int atlas_index);
-  void construct_face(BlockFaces face, int atlas_index, float x, float y,
-                      float z);
+  MeshingMode meshing_mode = MeshingMode::GREEDY;
+  std::atomic<ChunkState> state = ChunkState::PENDING;
+  // only touched by the render thread
+  bool mesh_uploaded = false;
+  bool gpu_resident = false;
+  // mesh jobs queued for the chunk that haven't come back out of
+  // pending_uploads yet, also only touched by the render thread
+  int pending_meshes = 0;
+  // last frame the chunk was inside the load radius, used for lru eviction
+  int64_t last_used_frame = 0;
+  // when the chunk was first in the frustum without a mesh, negative if it
+  // hasn't been since its last upload
+  double view_entered_time = -1.0;
+  // every voxel below this row is solid ground (not air or water), so the
+  // chunk's footprint up to it can occlude whatever is behind it
+  int solid_height = 0;
+
+  // fits the section's bounding box to its occupied rows
+  void update_bounding_box(int section);
+  // flood fills the section's non opaque voxels
+  void update_face_connectivity(int section);
+
+  static void emit_quad(std::vector<PackedVertex>& vertices, BlockFaces face,
+                        int atlas_index, int x, int y, int z, int width,
+                        int height);
+  bool is_section_hidden(int section, const Chunk& f_chunk,
+                         const Chunk& b_chunk, const Chunk& l_chunk,
+                         const Chunk& r_chunk) const;
+  std::unique_ptr<MeshSnapshot> create_mesh_snapshot(
+      const Chunk& f_chunk, const Chunk& b_chunk, const Chunk& l_chunk,
+      const Chunk& r_chunk) const;
+  void create_naive_mesh(int section, const MeshSnapshot& snapshot);
+  void create_greedy_mesh(int section, const MeshSnapshot& snapshot);
+  void create_binary_mesh(int section, const MeshSnapshot& snapshot);
   void create_voxels();
 
-  Voxel& get_voxel(int x, int y, int z) {
-    return voxels[x + z * CHUNK_WIDTH + y * CHUNK_WIDTH * CHUNK_DEPTH];
+  static int get_section_index(int x, int y, int z) {
+    return x + z * CHUNK_WIDTH + (y % SECTION_SIZE) * CHUNK_WIDTH * CHUNK_DEPTH;
   }
 
-  bool is_air_voxel(int x, int y, int z) {
-    return get_voxel(x, y, z).voxel_type == VoxelType::AIR;
+  Voxel get_voxel(int x, int y, int z) const {
+    return Voxel{.voxel_type = sections[y / SECTION_SIZE].voxels.get(
+                     get_section_index(x, y, z))};
   }
 
-  float get_x_offset() const {
-    return chunk_pos.x * CHUNK_WIDTH;
+  static int get_column_index(int x, int z) {
+    return (x + z * CHUNK_WIDTH) * OCCUPANCY_WORDS;
   }
 
-  float get_z_offset() const {
-    return chunk_pos.z * CHUNK_DEPTH;
+  static int get_atlas_index(VoxelType voxel_type, BlockFaces face) {
+    return BLOCK_FACE_ATLAS[(int)voxel_type][(int)face];
+  }
+
+  static PackedVertex pack_vertex(int x, int y, int z, BlockFaces face,
+                                  int atlas_index) {
+    return x | y << 5 | z << 14 | (int)face << 19 | atlas_index << 22;
   }
 
 public:
-  Chunk(ChunkPos chunk_pos, siv::PerlinNoise& perlin_noise);
+  Chunk(ChunkPos chunk_pos, TerrainGenerator& terrain_generator);
+  // NOTE: chunks are constructed in place and never copied, workers hold
+  // pointers to them
+  Chunk(const Chunk&) = delete;
+  Chunk& operator=(const Chunk&) = delete;
+  // runs on a generation worker
+  void generate();
+  // runs on a mesher, only reads the snapshot taken by request_mesh_creation.
+  // build_mesh fills the sections' vertices_buffer and returns false if the
+  // chunk wasn't MESHING, finish_mesh flags it READY for upload
+  bool build_mesh();
+  void finish_mesh();
   void create_mesh();
-  void set_neighbour_chunks(Chunk* u_chunk, Chunk* d_chunk, Chunk* l_chunk,
-                            Chunk* r_chunk);
 
-  void set_voxel(int x, int y, int z, VoxelType voxel_type) {
-    voxels[x + z * CHUNK_WIDTH + y * CHUNK_WIDTH * CHUNK_DEPTH] =
-        Voxel{.voxel_type = voxel_type};
+  [[nodiscard]] MeshingMode get_meshing_mode() const {
+    return meshing_mode;
   }
 
-  const float* get_vertices_data() const {
-    return vertices_buffer.data();
+  ChunkPos get_pos() const {
+    return chunk_pos;
   }
 
-  const float* get_water_vertices_data() const {
-    return water_vertices_buffer.data();
+  int get_x_offset() const {
+    return chunk_pos.x * CHUNK_WIDTH;
   }
 
-  const BoundingBox& get_bounding_box() const {
-    return bounding_box;
+  int get_z_offset() const {
+    return chunk_pos.z * CHUNK_DEPTH;
+  }
+
+  void set_voxel(int x, int y, int z, VoxelType voxel_type) {
+    sections[y / SECTION_SIZE].voxels.set(get_section_index(x, y, z),
+                                          voxel_type);
+    uint64_t& word = occupancy[get_column_index(x, z) + y / 64];
+    uint64_t bit = uint64_t(1) << (y % 64);
+    word = voxel_type == VoxelType::AIR ? word & ~bit : word | bit;
+    // NOTE: generate() fits every box once the whole chunk is filled in
+    if (is_generated()) {
+      update_bounding_box(y / SECTION_SIZE);
+      sections[y / SECTION_SIZE].connectivity_dirty = true;
+    }
+    if (y < solid_height && !is_opaque(voxel_type)) {
+      solid_height = y;
+    }
+  }
+
+  ChunkSection& get_section(int section) {
+    return sections[section];
   }
 
-  int get_vertices_byte_size() const {
-    return vertices_buffer.size() * sizeof(float);
+  const ChunkSection& get_section(int section) const {
+    return sections[section];
   }
 
-  int get_water_vertices_byte_size() const {
-    return water_vertices_buffer.size() * sizeof(float);
+  size_t get_voxels_byte_size() const {
+    size_t bytes = 0;
+    for (const auto& section : sections) {
+      bytes += section.voxels.get_byte_size();
+    }
+    return bytes;
   }
 
   const std::vector<WorldStructure>& get_structures() const {
     return structures;
   }
 
-  bool initial_mesh_created() const {
-    return mesh_created;
+  ChunkState get_state() const {
+    return state.load(std::memory_order_acquire);
   }
 
-  bool has_mesh_requested() const {
-    return mesh_creation_requested;
+  bool is_generated() const {
+    return get_state() >= ChunkState::GENERATED;
   }
 
-  void request_mesh_creation() {
-    mesh_creation_requested = true;
+  // called by the render thread right before handing generate() to a worker
+  void mark_queued() {
+    state.store(ChunkState::QUEUED, std::memory_order_release);
+  }
+
+  // also used to remesh a READY chunk. The uploaded mesh is kept around until
+  // its replacement is uploaded. Called by the render thread, snapshots the
+  // voxels the mesh will be built from
+  void request_mesh_creation(MeshingMode meshing_mode, const Chunk& f_chunk,
+                             const Chunk& b_chunk, const Chunk& l_chunk,
+                             const Chunk& r_chunk);
+
+  // called by the mesher between build_mesh and finish_mesh, then by the
+  // render thread once it has copied the mesh out
+  std::optional<StagingRange>& get_staged_mesh() {
+    return staged_mesh;
+  }
+
+  bool needs_upload() const {
+    return get_state() == ChunkState::READY && !mesh_uploaded;
+  }
+
+  bool is_gpu_resident() const {
+    return gpu_resident;
+  }
+
+  // called by the render thread once every section's mesh is uploaded
+  void mark_mesh_uploaded() {
+    mesh_uploaded = true;
+    gpu_resident = true;
+  }
+
+  // called by the render thread when a mesh job for the chunk is queued, and
+  // when that job leaves pending_uploads (uploaded or stale)
+  void add_pending_mesh() {
+    pending_meshes++;
+  }
+
+  void remove_pending_mesh() {
+    pending_meshes--;
+  }
+
+  // mesh_jobs, a mesher, finished_meshes or pending_uploads still holds a
+  // pointer to the chunk. NOTE: the state alone can't tell, a remeshed chunk
+  // is READY and uploaded while its stale job is still queued
+  bool is_mesh_in_flight() const {
+    return pending_meshes > 0;
+  }
+
+  void touch(int64_t frame) {
+    last_used_frame = frame;
+  }
+
+  int64_t get_last_used_frame() const {
+    return last_used_frame;
+  }
+
+  // only the first call before the next take_view_entered_time counts
+  void mark_entered_view(double time) {
+    if (view_entered_time < 0) {
+      view_entered_time = time;
+    }
+  }
+
+  // returns the time passed to mark_entered_view and clears it
+  double take_view_entered_time() {
+    return std::exchange(view_entered_time, -1.0);
+  }
+
+  int get_solid_height() const {
+    return solid_height;
+  }
+
+  // called by the render thread, which is the only one editing voxels once
+  // the chunk is generated
+  uint16_t get_face_connectivity(int section) {
+    auto& s = sections[section];
+    if (s.connectivity_dirty) {
+      update_face_connectivity(section);
+    }
+    return s.face_connectivity;
+  }
+
+  // cpu memory held by the chunk, gpu ranges are accounted by the allocator
+  size_t get_resident_byte_size() const {
+    size_t bytes = sizeof(Chunk);
+    if (is_generated()) {
+      bytes += get_voxels_byte_size();
+    }
+    return bytes;
   }
 
-private:
-  // clang-format off
-  std::unordered_map<VoxelType, std::unordered_map<BlockFaces, int>>
-      block_to_faces_map = {
-      {VoxelType::GRASS,
-      {
-        {BlockFaces::BOTTOM, 2},
-        {BlockFaces::TOP, 0},
-        {BlockFaces::LEFT, 3},
-        {BlockFaces::RIGHT, 3},
-        {BlockFaces::FRONT, 3},
-        {BlockFaces::BACK, 3},
-        }
-      },
-      {VoxelType::STONE,
-      {
-        {BlockFaces::BOTTOM, 1},
-        {BlockFaces::TOP, 1},
-        {BlockFaces::LEFT, 1},
-        {BlockFaces::RIGHT, 1},
-        {BlockFaces::FRONT, 1},
-        {BlockFaces::BACK, 1},
-        }
-      },
-      {VoxelType::WATER,
-      {
-        {BlockFaces::BOTTOM, 192 + 13},
-        {BlockFaces::TOP, 192 + 13},
-        {BlockFaces::LEFT, 192 + 13},
-        {BlockFaces::RIGHT, 192 + 13},
-        {BlockFaces::FRONT, 192 + 13},
-        {BlockFaces::BACK, 192 + 13},
-        }
-      },
-      {VoxelType::WOOD,
-      {
-        {BlockFaces::BOTTOM, 20},
-        {BlockFaces::TOP, 20},
-        {BlockFaces::LEFT, 20},
-        {BlockFaces::RIGHT, 20},
-        {BlockFaces::FRONT, 20},
-        {BlockFaces::BACK, 20},
-        }
-      },
-      {VoxelType::DIRT,
-      {
-        {BlockFaces::BOTTOM, 2},
-        {BlockFaces::TOP, 2},
-        {BlockFaces::LEFT, 2},
-        {BlockFaces::RIGHT, 2},
-        {BlockFaces::FRONT, 2},
-        {BlockFaces::BACK, 2}
-      }
-  }};
-  // clang-format on
 };
 
 constexpr auto chunk_vert = R"(
 #version 460 core
-layout (location = 0) in vec3 vertex_coord;
-layout (location = 1) in vec2 _tex_coord;
+layout (location = 0) in uint vertex;
 
-out vec2 tex_coord;
+// per draw chunk origins (world x, world z), indexed by gl_DrawID
+layout (std430, binding = 0) readonly buffer ChunkOrigins {
+  ivec2 chunk_origins[];
+};
+
+out vec2 tile_coord;
+flat out uint atlas_index;
 
-// uniform mat4 models[64];
-// uniform mat4 model;
 uniform mat4 view;
 uniform mat4 projection;
 
+// per face (BOTTOM, TOP, LEFT, RIGHT, BACK, FRONT): the local directions the
+// texture's u and v run along
+const vec3 TILE_U[6] = vec3[](vec3(1, 0, 0), vec3(1, 0, 0), vec3(0, 0, -1),
+                              vec3(0, 0, 1), vec3(-1, 0, 0), vec3(1, 0, 0));
+const vec3 TILE_V[6] = vec3[](vec3(0, 0, -1), vec3(0, 0, 1), vec3(0, 1, 0),
+                              vec3(0, 1, 0), vec3(0, 1, 0), vec3(0, 1, 0));
+
 void main() {
-  // gl_Position = projection * view * models[gl_DrawID] * vec4(vertex_coord, 1.0);
-  // gl_Position = projection * view * model * vec4(vertex_coord, 1.0);
-  gl_Position = projection * view * vec4(vertex_coord, 1.0);
-  tex_coord = _tex_coord;
+  vec3 local = vec3(vertex & 0x1fu, (vertex >> 5) & 0x1ffu,
+                    (vertex >> 14) & 0x1fu);
+  uint face = (vertex >> 19) & 0x7u;
+  atlas_index = (vertex >> 22) & 0xffu;
+
+  // NOTE: local z runs away from the player, world z towards them
+  ivec2 origin = chunk_origins[gl_DrawID];
+  vec3 world = vec3(origin.x + local.x, local.y, origin.y - local.z);
+  gl_Position = projection * view * vec4(world, 1.0);
+
+  // quads always start on voxel boundaries, so the local position along the
+  // face repeats the texture once per voxel even across merged quads
+  tile_coord = vec2(dot(local, TILE_U[face]), dot(local, TILE_V[face]));
 }
   )";
 
@@ -250,10 +544,17 @@ constexpr auto chunk_frag = R"(
 
 layout (binding = 0) uniform sampler2D tex_atlas;
 
-in vec2 tex_coord;
+in vec2 tile_coord;
+flat in uint atlas_index;
 out vec4 frag_color;
 
+const uint TEX_ATLAS_ROWS = 16;
+
 void main() {
-  frag_color = texture(tex_atlas, tex_coord);
+  // wrap tile coords within the atlas tile so merged quads repeat the texture.
+  // NOTE: v is flipped to account for uv coords starting at bottom left
+  vec2 tile = vec2(atlas_index % TEX_ATLAS_ROWS, atlas_index / TEX_ATLAS_ROWS);
+  vec2 uv = vec2(fract(tile_coord.x), 1.0 - fract(tile_coord.y));
+  frag_color = texture(tex_atlas, (tile + uv) / float(TEX_ATLAS_ROWS));
 }
   )";
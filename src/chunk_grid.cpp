@@ -0,0 +1,99 @@
+#include "chunk_grid.h"
+#include "common.h"
+
+ChunkGrid::ChunkGrid(int radius)
+    : radius(radius), size(2 * radius + 1), slots(size * size) {
+}
+
+std::unique_ptr<Chunk>& ChunkGrid::get_slot(ChunkPos w) {
+  if (in_window(w)) {
+    return slots[get_slot_index(w)];
+  }
+  return outside[w];
+}
+
+void ChunkGrid::recentre(ChunkPos center) {
+  if (center == this->center) {
+    return;
+  }
+  this->center = center;
+
+  // NOTE: once every chunk left in a slot is inside the new window, each of
+  // them sits in its own slot, so the chunks moved in below can't collide
+  for (auto& slot : slots) {
+    if (slot && !in_window(slot->get_pos())) {
+      auto pos = slot->get_pos();
+      outside.emplace(pos, std::move(slot));
+    }
+  }
+  adopt_outside_chunks();
+}
+
+void ChunkGrid::resize(int radius) {
+  if (radius == this->radius) {
+    return;
+  }
+  std::vector<std::unique_ptr<Chunk>> chunks;
+  for (auto& slot : slots) {
+    if (slot) {
+      chunks.push_back(std::move(slot));
+    }
+  }
+
+  this->radius = radius;
+  size = 2 * radius + 1;
+  slots.clear();
+  slots.resize(size * size);
+  for (auto& chunk : chunks) {
+    auto pos = chunk->get_pos();
+    get_slot(pos) = std::move(chunk);
+  }
+  adopt_outside_chunks();
+}
+
+void ChunkGrid::adopt_outside_chunks() {
+  for (auto it = outside.begin(); it != outside.end();) {
+    if (in_window(it->first)) {
+      slots[get_slot_index(it->first)] = std::move(it->second);
+      it = outside.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
+Chunk* ChunkGrid::find(ChunkPos w) {
+  return const_cast<Chunk*>(std::as_const(*this).find(w));
+}
+
+const Chunk* ChunkGrid::find(ChunkPos w) const {
+  if (in_window(w)) {
+    // the slot may hold nothing yet
+    auto& slot = slots[get_slot_index(w)];
+    return slot ? slot.get() : nullptr;
+  }
+  auto it = outside.find(w);
+  return it != outside.end() ? it->second.get() : nullptr;
+}
+
+Chunk& ChunkGrid::at(ChunkPos w) {
+  auto* chunk = find(w);
+  if (!chunk) {
+    PANIC("Chunk ({}, {}) is not loaded!\n", w.x, w.z);
+  }
+  return *chunk;
+}
+
+void ChunkGrid::erase(ChunkPos w) {
+  if (in_window(w)) {
+    auto& slot = slots[get_slot_index(w)];
+    if (slot) {
+      slot.reset();
+      chunk_count--;
+    }
+    return;
+  }
+  if (outside.erase(w) != 0) {
+    chunk_count--;
+  }
+}
@@ -0,0 +1,96 @@
+#pragma once
+#include "chunk.h"
+#include <cstdlib>
+#include <memory>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// toroidal 2d grid of chunk slots centred on the player. A chunk inside the
+// window lives in slot (x mod size, z mod size), so lookups are just index
+// math and recentring only moves the chunks that fall off the window's edge.
+// Chunks outside the window (eg: ones that can't be unloaded yet because a
+// worker still points to them) are kept in a fallback map.
+// NOTE: chunks are heap allocated and never move, workers keep raw pointers to
+// them for as long as they are in the grid
+class ChunkGrid {
+private:
+  int radius;
+  int size;
+  ChunkPos center{.x = 0, .z = 0};
+  std::vector<std::unique_ptr<Chunk>> slots;
+  std::unordered_map<ChunkPos, std::unique_ptr<Chunk>> outside;
+  size_t chunk_count = 0;
+
+  int get_slot_index(ChunkPos w) const {
+    int x = ((w.x % size) + size) % size;
+    int z = ((w.z % size) + size) % size;
+    return x + z * size;
+  }
+
+  std::unique_ptr<Chunk>& get_slot(ChunkPos w);
+  // moves fallback chunks that are now inside the window into their slots
+  void adopt_outside_chunks();
+
+public:
+  explicit ChunkGrid(int radius);
+
+  // moves chunks leaving the window into the fallback map and chunks entering
+  // it into their slots
+  void recentre(ChunkPos center);
+  // same for a window of a new radius
+  void resize(int radius);
+
+  [[nodiscard]] bool in_window(ChunkPos w) const {
+    return std::abs(w.x - center.x) <= radius &&
+           std::abs(w.z - center.z) <= radius;
+  }
+
+  Chunk* find(ChunkPos w);
+  const Chunk* find(ChunkPos w) const;
+  // panics if the chunk isn't loaded
+  Chunk& at(ChunkPos w);
+
+  // constructs Chunk(args...) at w unless a chunk is already there
+  template <typename... Args>
+  std::pair<Chunk*, bool> try_emplace(ChunkPos w, Args&&... args) {
+    auto& slot = get_slot(w);
+    if (slot) {
+      return {slot.get(), false};
+    }
+    slot = std::make_unique<Chunk>(std::forward<Args>(args)...);
+    chunk_count++;
+    return {slot.get(), true};
+  }
+
+  void erase(ChunkPos w);
+
+  // f(ChunkPos, Chunk&) for every loaded chunk, in no particular order
+  template <typename F>
+  void for_each(F&& f) {
+    for (auto& slot : slots) {
+      if (slot) {
+        f(slot->get_pos(), *slot);
+      }
+    }
+    for (auto& [pos, chunk] : outside) {
+      f(pos, *chunk);
+    }
+  }
+
+  template <typename F>
+  void for_each(F&& f) const {
+    for (const auto& slot : slots) {
+      if (slot) {
+        f(slot->get_pos(), static_cast<const Chunk&>(*slot));
+      }
+    }
+    for (const auto& [pos, chunk] : outside) {
+      f(pos, static_cast<const Chunk&>(*chunk));
+    }
+  }
+
+  [[nodiscard]] size_t get_chunk_count() const {
+    return chunk_count;
+  }
+};
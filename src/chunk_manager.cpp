@@ -1,24 +1,56 @@
 #include "chunk_manager.h"
 #include "chunk.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
 #include <thread>
 
-ChunkManager::ChunkManager(PlayerCamera& player_camera)
+// front, back, left, right
+static std::array<ChunkPos, 4> neighbour_positions(ChunkPos w) {
+  return {ChunkPos{.x = w.x, .z = w.z + 1}, ChunkPos{.x = w.x, .z = w.z - 1},
+          ChunkPos{.x = w.x - 1, .z = w.z}, ChunkPos{.x = w.x + 1, .z = w.z}};
+}
+
+ChunkManager::ChunkManager(PlayerCamera& player_camera,
+                           std::optional<uint32_t> seed,
+                           const EngineConfig& config)
     : player_camera(player_camera),
+      gpu_bytes_allocated(config.gpu_megabytes * 1024 * 1024),
+      max_gpu_bytes(config.max_gpu_megabytes * 1024 * 1024),
       shader_program(chunk_vert, chunk_frag, ShaderSourceType::STRING),
-      perlin_noise(random_seed()) {
-
-  mesh_gen_thread = std::thread(
-      [](std::deque<Chunk*>& mesh_gen_queue) {
-        while (true) {
-          while (!mesh_gen_queue.empty()) {
-            mesh_gen_queue[0]->create_mesh();
-            mesh_gen_queue.pop_front();
-          }
-          PRINT("");
+      gpu_allocator(gpu_bytes_allocated, sizeof(PackedVertex)),
+      terrain_generator(seed ? *seed : random_seed(),
+                        config.smooth_terrain
+                            ? CurveInterpolation::MONOTONE_CUBIC
+                            : CurveInterpolation::LINEAR),
+      mesh_distance(config.view_distance),
+      load_distance(mesh_distance + config.load_margin),
+      unload_distance(load_distance + config.unload_margin),
+      load_margin(config.load_margin), unload_margin(config.unload_margin),
+      min_view_distance(config.min_view_distance),
+      max_view_distance(config.view_distance),
+      auto_view_distance(config.auto_view_distance),
+      view_distance_scaler(config.target_frame_ms),
+      resident_bytes_budget(config.resident_megabytes * 1024 * 1024) {
+  PRINT("[DEBUG] seed: {}\n", terrain_generator.get_seed());
+
+  for (auto i = 0; i < mesher_count(); i++) {
+    mesh_workers.emplace_back([this]() {
+      while (auto chunk = mesh_jobs.pop()) {
+        auto before = std::chrono::steady_clock::now();
+        bool built = (*chunk)->build_mesh();
+        auto after = std::chrono::steady_clock::now();
+        mesh_time_ns += (after - before).count();
+        meshes_built++;
+        // NOTE: not timed, it can wait on the render thread for room
+        if (built) {
+          stage_mesh(**chunk);
+          (*chunk)->finish_mesh();
         }
-      },
-      std::ref(mesh_gen_queue));
-  mesh_gen_thread.detach();
+        finished_meshes.push(*chunk);
+      }
+    });
+  }
 
   shader_program.set_uniform_matrix<UniformMSize::FOUR>(
       "projection", 1, false,
@@ -53,69 +85,98 @@ ChunkManager::ChunkManager(PlayerCamera& player_camera)
   // vertex attribute configuration
   glCreateVertexArrays(1, &vao);
 
-  // vertice
+  // packed vertex, decoded in the vertex shader
   glEnableVertexArrayAttrib(vao, 0);
-  glVertexArrayAttribFormat(vao, 0, 3, GL_FLOAT, GL_FALSE, 0);
+  glVertexArrayAttribIFormat(vao, 0, 1, GL_UNSIGNED_INT, 0);
   glVertexArrayAttribBinding(vao, 0, 0);
 
-  // tex coord
-  glEnableVertexArrayAttrib(vao, 1);
-  glVertexArrayAttribFormat(vao, 1, 2, GL_FLOAT, GL_FALSE, sizeof(float) * 3);
-  glVertexArrayAttribBinding(vao, 1, 0);
-
   // gpu memory
+  // NOTE: chunk meshes stay resident in here, ranges are handed out by
+  // gpu_allocator. Only ever written by copies from staging_ring
   glCreateBuffers(1, &vbo);
-  glNamedBufferData(vbo, gpu_bytes_allocated, nullptr, GL_DYNAMIC_DRAW);
-  glVertexArrayVertexBuffer(vao, 0, vbo, 0,
-                            sizeof(float) * attributes_per_vertice);
+  glNamedBufferStorage(vbo, gpu_bytes_allocated, nullptr, 0);
+  glVertexArrayVertexBuffer(vao, 0, vbo, 0, sizeof(PackedVertex));
+
+  std::vector<uint16_t> quad_indices;
+  quad_indices.reserve(MAX_QUADS_PER_SECTION * 6);
+  for (auto quad = 0; quad < MAX_QUADS_PER_SECTION; quad++) {
+    for (auto index : QUAD_INDICES) {
+      quad_indices.push_back(quad * 4 + index);
+    }
+  }
+  glCreateBuffers(1, &quad_ebo);
+  glNamedBufferStorage(quad_ebo, quad_indices.size() * sizeof(uint16_t),
+                       quad_indices.data(), 0);
+  glVertexArrayElementBuffer(vao, quad_ebo);
+
+  // indirect draw commands and the per draw chunk origins
+  reserve_draw_buffers(1);
 }
 
-void ChunkManager::manage_chunks(glm::vec3 pos) {
-  visible_list.clear();
-  render_list.clear();
-  structures_to_be_generated.clear();
-  cpu_bytes_allocated = 0;
-  ChunkPos world_chunk_pos;
+ChunkManager::~ChunkManager() {
+  // stop the meshers before any chunk they might be working on goes away
+  mesh_jobs.close();
+  staging_ring.close();
+  for (auto& worker : mesh_workers) {
+    worker.join();
+  }
+}
+
+int ChunkManager::mesher_count() {
+  return std::max(1, (int)std::thread::hardware_concurrency() / 4);
+}
 
+// the chunk containing a world position
+static ChunkPos get_chunk_pos(glm::vec3 pos) {
+  ChunkPos w;
   if (pos.x >= 0) {
-    world_chunk_pos.x = (int)(pos.x / CHUNK_WIDTH);
+    w.x = (int)(pos.x / CHUNK_WIDTH);
   } else {
-    world_chunk_pos.x = floor(pos.x / CHUNK_WIDTH);
+    w.x = floor(pos.x / CHUNK_WIDTH);
   }
 
   if (pos.z >= 0) {
-    world_chunk_pos.z = ceil(pos.z / CHUNK_DEPTH);
+    w.z = ceil(pos.z / CHUNK_DEPTH);
   } else {
-    world_chunk_pos.z = (int)(pos.z / CHUNK_DEPTH);
+    w.z = (int)(pos.z / CHUNK_DEPTH);
   }
+  return w;
+}
 
-  // NOTE: we create voxel data for radius view_distance+1, but only generate
-  // voxel information for view_distance in order to cull chunk borders
+void ChunkManager::manage_chunks(glm::vec3 pos) {
+  frame_index++;
+  visible_list.clear();
+  visible_boxes.clear();
+  render_list.clear();
+  ChunkPos world_chunk_pos = get_chunk_pos(pos);
+
+  world_chunks.recentre(world_chunk_pos);
+  update_camera_motion(pos);
+  player_camera.update_frustum();
+
+  // NOTE: we create voxel data for radius load_distance, but only generate
+  // meshes for mesh_distance in order to cull chunk borders
 
-  //  TODO: this is the next major performance bottleneck
   // voxel creation pass
+  // NOTE: generation happens on generation_pool, chunks that aren't generated
+  // yet are just skipped by the passes below
   double before = glfwGetTime();
-  for (int dx = -view_distance - 1; dx <= view_distance + 1; ++dx) {
-    for (int dz = -view_distance - 1; dz <= view_distance + 1; ++dz) {
+  generation_candidates.clear();
+  for (int dx = -load_distance; dx <= load_distance; ++dx) {
+    for (int dz = -load_distance; dz <= load_distance; ++dz) {
       auto w =
           ChunkPos{.x = world_chunk_pos.x + dx, .z = world_chunk_pos.z + dz};
 
-      if (world_chunks.find(w) == world_chunks.end()) {
-        auto chunk = Chunk(w, perlin_noise);
-        world_chunks.insert({w, chunk});
+      auto* chunk = world_chunks.try_emplace(w, w, terrain_generator).first;
+      if (chunk->get_state() == ChunkState::PENDING) {
+        generation_candidates.push_back(LoadCandidate{
+            .priority = get_load_priority(w, pos), .pos = w, .chunk = chunk});
       }
+      chunk->touch(frame_index);
     }
   }
-
-  /*
-  // TODO: add to vector for each frame
-  for (const auto& structure : structures_to_be_generated) {
-    switch (structure.structure_type) {
-      case StructureType::TREE:
-        break;
-    }
-  }
-  */
+  prefetch_chunks(world_chunk_pos, pos);
+  dispatch_generation_jobs();
 
   double after = glfwGetTime();
   if ((after - before) * 1000 > 5) {
@@ -124,62 +185,661 @@ void ChunkManager::manage_chunks(glm::vec3 pos) {
 
   // visible chunks pass and mesh creation pass
   before = glfwGetTime();
-  for (int dx = -view_distance; dx <= view_distance; ++dx) {
-    for (int dz = -view_distance; dz <= view_distance; ++dz) {
+  chunks_loading = 0;
+  missing_chunk_count = 0;
+  occluders.clear();
+  mesh_candidates.clear();
+  for (int dx = -mesh_distance; dx <= mesh_distance; ++dx) {
+    for (int dz = -mesh_distance; dz <= mesh_distance; ++dz) {
       auto w =
           ChunkPos{.x = world_chunk_pos.x + dx, .z = world_chunk_pos.z + dz};
 
       auto& chunk = world_chunks.at(w);
-      if (!chunk.initial_mesh_created() && !chunk.has_mesh_requested()) {
-        for (const auto& structure : chunk.get_structures()) {
-          place_structure_within_chunk(w, structure.x, structure.y, structure.z,
-                                       structure.structure_type);
+      if (!chunk.is_gpu_resident() || chunk.is_mesh_in_flight()) {
+        chunks_loading++;
+      }
+      if (std::max(std::abs(dx), std::abs(dz)) <= occluder_distance) {
+        add_occluder(chunk, pos);
+      }
+
+      if (chunk.get_state() == ChunkState::GENERATED &&
+          neighbours_generated(w)) {
+        mesh_candidates.push_back(LoadCandidate{
+            .priority = get_load_priority(w, pos), .pos = w, .chunk = &chunk});
+      }
+
+      // NOTE: the whole column, sections only get their boxes once generated
+      if (!chunk.is_gpu_resident()) {
+        auto column = BoundingBox{
+            .min = glm::vec3(chunk.get_x_offset(), 0,
+                             chunk.get_z_offset() - CHUNK_DEPTH),
+            .max = glm::vec3(chunk.get_x_offset() + CHUNK_WIDTH, CHUNK_HEIGHT,
+                             chunk.get_z_offset())};
+        if (player_camera.frustum.test_bounding_box(column)) {
+          chunk.mark_entered_view(before);
+          missing_chunk_count++;
         }
+      }
 
-        auto& f_chunk = world_chunks.at(ChunkPos{.x = w.x, .z = w.z + 1});
-        auto& b_chunk = world_chunks.at(ChunkPos{.x = w.x, .z = w.z - 1});
-        auto& l_chunk = world_chunks.at(ChunkPos{.x = w.x - 1, .z = w.z});
-        auto& r_chunk = world_chunks.at(ChunkPos{.x = w.x + 1, .z = w.z});
-        chunk.set_neighbour_chunks(&f_chunk, &b_chunk, &l_chunk, &r_chunk);
-        chunk.request_mesh_creation();
-        mesh_gen_queue.push_back(&chunk);
-      } else {
-        visible_list.push_back(ChunkDrawData{.chunk = &chunk});
+      if (chunk.is_gpu_resident()) {
+        for (auto i = 0; i < SECTIONS_PER_CHUNK; i++) {
+          auto& section = chunk.get_section(i);
+          if (section.gpu_vertex_count != 0) {
+            visible_list.push_back(
+                ChunkDrawData{.chunk = &chunk, .section = i});
+            visible_boxes.push_back(section.bounding_box);
+          }
+        }
       }
     }
   }
+  dispatch_mesh_jobs();
   after = glfwGetTime();
   if ((after - before) * 1000 > 5) {
     PRINT("Voxel Mesh: {}\n", (after - before) * 1000);
   }
 
   before = glfwGetTime();
-  player_camera.update_frustum();
-  for (auto& i : visible_list) {
-    if (player_camera.frustum.test_bounding_box(i.chunk->get_bounding_box())) {
-      render_list.push_back(i);
+  player_camera.frustum.test_bounding_boxes(visible_boxes, in_frustum);
+  if (cave_culling) {
+    cave_culler.find_reachable(
+        world_chunk_pos, pos.y, player_camera.frustum,
+        [&](ChunkPos w, int section) {
+          auto* chunk = world_chunks.find(w);
+          if (!chunk || !chunk->is_generated()) {
+            return ALL_FACES_CONNECTED;
+          }
+          return chunk->get_face_connectivity(section);
+        });
+  }
+  frustum_section_count = 0;
+  in_frustum_boxes.clear();
+  for (size_t i = 0; i < visible_list.size(); i++) {
+    if (!((in_frustum[i / 64] >> (i % 64)) & 1)) {
+      continue;
+    }
+    frustum_section_count++;
+    auto& drawable = visible_list[i];
+    if (cave_culling &&
+        !cave_culler.is_reachable(drawable.chunk->get_pos(),
+                                  drawable.section)) {
+      continue;
     }
+    render_list.push_back(drawable);
+    in_frustum_boxes.push_back(visible_boxes.get(i));
   }
+  connected_section_count = render_list.size();
   after = glfwGetTime();
   if ((after - before) * 1000 > 5) {
-    PRINT("Voxel Mesh: {}\n", (after - before) * 1000);
+    PRINT("Frustum Culling: {}\n", (after - before) * 1000);
   }
 
-  for (auto& drawable : render_list) {
-    drawable.offset =
-        cpu_bytes_allocated / sizeof(float) / attributes_per_vertice;
+  // the occlusion pass runs on its own thread while the meshes are uploaded
+  // NOTE: uploads can change the meshes of sections in render_list, which is
+  // fine as draws only read them in render_chunks
+  auto view_projection =
+      *player_camera.get_projection_matrix() * *player_camera.get_view_matrix();
+  bool occlusion_started =
+      occlusion_culling &&
+      occlusion_culler.begin_pass(view_projection, occluders, in_frustum_boxes);
+
+  upload_pending_meshes();
+
+  // NOTE: runs after the uploads so chunks whose mesh just finished can go.
+  // Chunks in render_list were touched this frame, so they're never unloaded
+  unload_chunks(world_chunk_pos);
+
+  occlusion_applied = false;
+  if (occlusion_started) {
+    // past the budget the frame is drawn with just frustum culling, and the
+    // late pass's result is dropped
+    auto* visible = occlusion_culler.wait_for_pass(occlusion_budget);
+    if (visible) {
+      size_t kept = 0;
+      for (size_t i = 0; i < render_list.size(); i++) {
+        if (((*visible)[i / 64] >> (i % 64)) & 1) {
+          render_list[kept++] = render_list[i];
+        }
+      }
+      render_list.resize(kept);
+      occlusion_applied = true;
+    }
+  }
+}
+
+// the solid ground under a chunk, from the bottom of the world up to its
+// lowest column. Only added once the chunk's mesh is drawn, so there are no
+// holes in the world hiding what is behind them
+// NOTE: skipped while the camera is inside it, it would hide everything
+void ChunkManager::add_occluder(const Chunk& chunk, glm::vec3 camera_pos) {
+  if (!chunk.is_gpu_resident() || chunk.get_solid_height() <= 0) {
+    return;
+  }
+  auto bb = BoundingBox{
+      .min = glm::vec3(chunk.get_x_offset(), 0,
+                       chunk.get_z_offset() - CHUNK_DEPTH),
+      .max = glm::vec3(chunk.get_x_offset() + CHUNK_WIDTH,
+                       chunk.get_solid_height(), chunk.get_z_offset())};
+  if (camera_pos.x >= bb.min.x && camera_pos.x <= bb.max.x &&
+      camera_pos.y <= bb.max.y && camera_pos.z >= bb.min.z &&
+      camera_pos.z <= bb.max.z) {
+    return;
+  }
+  occluders.push_back(bb);
+}
+
+static int get_staged_byte_size(Chunk& chunk) {
+  int bytes = 0;
+  for (auto i = 0; i < SECTIONS_PER_CHUNK; i++) {
+    bytes += chunk.get_section(i).staged_vertex_count * sizeof(PackedVertex);
+  }
+  return bytes;
+}
+
+// runs on the mesher between build_mesh and finish_mesh: writes every
+// section's vertices into one range of the staging ring and frees the cpu
+// copy, so the render thread only has to issue the gpu copies
+// NOTE: waits while the ring is full, until the render thread has uploaded
+// enough of the meshes ahead of this one
+void ChunkManager::stage_mesh(Chunk& chunk) {
+  auto& staged = chunk.get_staged_mesh();
+  // the mesh from before a remesh, if it never got uploaded
+  if (staged) {
+    staging_ring.drop(*staged);
+    staged = std::nullopt;
+  }
+
+  int bytes = 0;
+  for (auto i = 0; i < SECTIONS_PER_CHUNK; i++) {
+    auto& section = chunk.get_section(i);
+    section.staged_vertex_count = 0;
+    bytes += section.vertices_buffer.size() * sizeof(PackedVertex);
+  }
+  if (bytes == 0) {
+    return;
+  }
+  // closed, the manager is going away and nothing gets uploaded anymore
+  staged = staging_ring.allocate(bytes);
+  if (!staged) {
+    return;
+  }
+
+  // NOTE: the mapping is coherent and the render thread only issues the copy
+  // after seeing the chunk READY, so the writes are visible to it
+  char* out = staging_ring.get_pointer(*staged);
+  for (auto i = 0; i < SECTIONS_PER_CHUNK; i++) {
+    auto& section = chunk.get_section(i);
+    int section_bytes = section.vertices_buffer.size() * sizeof(PackedVertex);
+    std::memcpy(out, section.vertices_buffer.data(), section_bytes);
+    out += section_bytes;
+    section.staged_vertex_count = section.vertices_buffer.size();
+    std::vector<PackedVertex>().swap(section.vertices_buffer);
+  }
+}
+
+// uploads meshes finished since last frame, oldest first, until this frame's
+// upload budget is spent
+void ChunkManager::upload_pending_meshes() {
+  while (auto chunk = finished_meshes.try_pop()) {
+    pending_uploads.push_back(*chunk);
+  }
+
+  double before = glfwGetTime();
+  staging_ring.begin_frame();
+  gpu_memory_full = false;
+  int upload_bytes_left = UPLOAD_BYTES_PER_FRAME;
+  while (!pending_uploads.empty()) {
+    auto& chunk = *pending_uploads.front();
+    // NOTE: chunks remeshed since being queued come back through
+    // finished_meshes, so they're just dropped here
+    if (chunk.needs_upload()) {
+      int bytes = get_staged_byte_size(chunk);
+      if (bytes > upload_bytes_left) {
+        break;
+      }
+      // waits at the front until unloading (or a smaller view distance) frees
+      // up enough of the vbo
+      if (!upload_chunk_mesh(chunk)) {
+        gpu_memory_full = true;
+        break;
+      }
+      upload_bytes_left -= bytes;
+      // drawn this frame unless occluded
+      double entered = chunk.take_view_entered_time();
+      if (entered >= 0.0) {
+        double latency = (before - entered) * 1000;
+        load_latencies[load_latency_count++ % LOAD_LATENCY_SAMPLES] = latency;
+        load_latency_total_ms += latency;
+        load_latency_worst_ms = std::max(load_latency_worst_ms, latency);
+      }
+    }
+    chunk.remove_pending_mesh();
+    pending_uploads.pop_front();
+  }
+  staging_ring.end_frame();
+  double after = glfwGetTime();
+  if ((after - before) * 1000 > 5) {
+    PRINT("Mesh Upload: {}\n", (after - before) * 1000);
+  }
+}
+
+// copies a staged mesh into its own ranges of the vbo, one per non empty
+// section. This only happens once per mesh, drawing afterwards just references
+// the stored ranges
+// every section's range is allocated before anything changes, so a mesh that
+// doesn't fit even after growing the vbo leaves the chunk as it was (still
+// drawn with its old mesh, if it had one, and still staged) and returns false
+bool ChunkManager::upload_chunk_mesh(Chunk& chunk) {
+  std::array<std::optional<GpuAllocation>, SECTIONS_PER_CHUNK> allocations;
+  for (auto i = 0; i < SECTIONS_PER_CHUNK; i++) {
+    int bytes =
+        chunk.get_section(i).staged_vertex_count * sizeof(PackedVertex);
+    if (bytes == 0) {
+      continue;
+    }
+    allocations[i] = gpu_allocator.allocate(bytes);
+    if (!allocations[i] && grow_vertex_buffer(bytes)) {
+      allocations[i] = gpu_allocator.allocate(bytes);
+    }
+    if (!allocations[i]) {
+      for (auto& allocation : allocations) {
+        if (allocation) {
+          gpu_allocator.release(*allocation);
+        }
+      }
+      return false;
+    }
+  }
+
+  release_chunk_mesh(chunk);
+  auto& staged = chunk.get_staged_mesh();
+  // sections are staged back to back, empty ones take up no room
+  int staging_offset = staged ? staged->offset : 0;
+  for (auto i = 0; i < SECTIONS_PER_CHUNK; i++) {
+    auto& section = chunk.get_section(i);
+    auto& allocation = allocations[i];
+    if (!allocation) {
+      continue;
+    }
+    int bytes = section.staged_vertex_count * sizeof(PackedVertex);
+    glCopyNamedBufferSubData(staging_ring.get_buffer(), vbo, staging_offset,
+                             allocation->offset, bytes);
+    staging_offset += bytes;
+    section.gpu_allocation = allocation;
+    section.gpu_vertex_count = section.staged_vertex_count;
+  }
+  // freed once the gpu is done copying out of it
+  if (staged) {
+    staging_ring.release(*staged);
+    staged = std::nullopt;
+  }
+  chunk.mark_mesh_uploaded();
+  return true;
+}
+
+// doubles the vbo (or more, to fit bytes) up to max_gpu_bytes. The old
+// contents are copied over on the gpu, so every allocation keeps its offset
+// NOTE: copies into the old vbo issued earlier this frame come before the copy
+// in the command stream, so they make it over too
+bool ChunkManager::grow_vertex_buffer(int bytes) {
+  // NOTE: doubled in 64 bits, max_gpu_bytes is close to INT_MAX at most
+  int capacity = (int)std::min<int64_t>(
+      max_gpu_bytes, std::max<int64_t>(gpu_bytes_allocated * int64_t(2),
+                                       gpu_bytes_allocated + bytes));
+  if (capacity - gpu_bytes_allocated < bytes) {
+    return false;
+  }
+
+  GLuint grown;
+  glCreateBuffers(1, &grown);
+  glNamedBufferStorage(grown, capacity, nullptr, 0);
+  glCopyNamedBufferSubData(vbo, grown, 0, 0, gpu_bytes_allocated);
+  glDeleteBuffers(1, &vbo);
+  vbo = grown;
+  glVertexArrayVertexBuffer(vao, 0, vbo, 0, sizeof(PackedVertex));
+
+  PRINT("[DEBUG] Grew the mesh buffer to {}MB\n", capacity / (1024 * 1024));
+  gpu_bytes_allocated = capacity;
+  gpu_allocator.grow(capacity);
+  return true;
+}
+
+// NOTE: also frees the sections' draw slots, update_draw_commands adds them
+// back with the new mesh while they're visible
+void ChunkManager::release_chunk_mesh(Chunk& chunk) {
+  for (auto i = 0; i < SECTIONS_PER_CHUNK; i++) {
+    auto& section = chunk.get_section(i);
+    if (section.draw_slot >= 0) {
+      remove_draw(section.draw_slot);
+    }
+    if (section.gpu_allocation) {
+      gpu_allocator.release(*section.gpu_allocation);
+      section.gpu_allocation = std::nullopt;
+      section.gpu_vertex_count = 0;
+    }
+  }
+}
+
+// meshing reads the border voxels of the four neighbouring chunks
+// NOTE: neighbours can be missing for chunks past the load radius that haven't
+// been unloaded yet
+bool ChunkManager::neighbours_generated(ChunkPos w) {
+  for (auto n : neighbour_positions(w)) {
+    auto* neighbour = world_chunks.find(n);
+    if (!neighbour || !neighbour->is_generated()) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// the camera's facing and (smoothed) velocity on the xz plane, which skew the
+// load order
+void ChunkManager::update_camera_motion(glm::vec3 pos) {
+  auto front = player_camera.get_front();
+  camera_forward = glm::vec3(front.x, 0.0f, front.z);
+  float forward_length = glm::length(camera_forward);
+  // looking straight up or down faces no chunk in particular
+  camera_forward = forward_length > 1e-3f ? camera_forward / forward_length
+                                          : glm::vec3(0.0f);
+
+  double now = glfwGetTime();
+  if (last_frame_time >= 0.0 && now > last_frame_time) {
+    auto velocity = (pos - last_camera_pos) / (float)(now - last_frame_time);
+    velocity.y = 0.0f;
+    camera_velocity = camera_velocity * 0.8f + velocity * 0.2f;
+  }
+  last_camera_pos = pos;
+  last_frame_time = now;
+}
+
+// xz distance from the camera to the chunk's centre, shrunk by up to
+// FACING_WEIGHT + HEADING_WEIGHT for chunks straight ahead of the camera and
+// of where it is moving, grown by as much for the ones behind
+float ChunkManager::get_load_priority(ChunkPos w, glm::vec3 pos) const {
+  auto offset =
+      glm::vec3(w.x * CHUNK_WIDTH + CHUNK_WIDTH / 2.0f - pos.x, 0.0f,
+                w.z * CHUNK_DEPTH - CHUNK_DEPTH / 2.0f - pos.z);
+  float distance = glm::length(offset);
+  if (distance < 1.0f) {
+    return 0.0f;
+  }
+  auto direction = offset / distance;
+
+  float speed = glm::length(camera_velocity);
+  float heading = 0.0f;
+  if (speed > 1e-3f) {
+    heading = glm::dot(direction, camera_velocity) / speed *
+              std::min(1.0f, speed / FULL_SPEED);
+  }
+  float facing = glm::dot(direction, camera_forward);
+  return distance *
+         (1.0f - FACING_WEIGHT * facing - HEADING_WEIGHT * heading);
+}
+
+// sorts just enough of the candidates to hand out count of them
+static void take_highest_priority(std::vector<LoadCandidate>& candidates,
+                                  int count) {
+  count = std::clamp(count, 0, (int)candidates.size());
+  std::partial_sort(
+      candidates.begin(), candidates.begin() + count, candidates.end(),
+      [](const auto& a, const auto& b) { return a.priority < b.priority; });
+  candidates.resize(count);
+}
+
+// chunks in the ring between the load and unload radius that the camera is
+// heading into within PREFETCH_SECONDS, going by its velocity. They're kept
+// (and generated, not meshed) ahead of time, nearest first, until they hold
+// prefetch_bytes_budget of memory
+// NOTE: the ring is inside world_chunks' grid, so prefetched chunks never
+// spill into its fallback map
+void ChunkManager::prefetch_chunks(ChunkPos center, glm::vec3 pos) {
+  prefetch_candidates.clear();
+  prefetched_chunk_count = 0;
+  if (!prefetch || glm::length(camera_velocity) < PREFETCH_MIN_SPEED) {
+    return;
+  }
+
+  std::array<ChunkPos, PREFETCH_STEPS> path;
+  for (auto step = 0; step < PREFETCH_STEPS; step++) {
+    float time = PREFETCH_SECONDS * (step + 1) / PREFETCH_STEPS;
+    path[step] = get_chunk_pos(pos + camera_velocity * time);
+  }
+
+  for (int dx = -unload_distance; dx <= unload_distance; ++dx) {
+    for (int dz = -unload_distance; dz <= unload_distance; ++dz) {
+      if (std::max(std::abs(dx), std::abs(dz)) <= load_distance) {
+        continue;
+      }
+      auto w = ChunkPos{.x = center.x + dx, .z = center.z + dz};
+      bool on_path = std::any_of(path.begin(), path.end(), [&](ChunkPos p) {
+        return std::max(std::abs(w.x - p.x), std::abs(w.z - p.z)) <=
+               load_distance;
+      });
+      if (on_path) {
+        prefetch_candidates.push_back(LoadCandidate{
+            .priority = get_load_priority(w, pos), .pos = w, .chunk = nullptr});
+      }
+    }
+  }
+  std::sort(
+      prefetch_candidates.begin(), prefetch_candidates.end(),
+      [](const auto& a, const auto& b) { return a.priority < b.priority; });
+
+  // chunks still to be generated are counted at the average chunk's size
+  size_t average_bytes =
+      std::max(resident_bytes /
+                   std::max<size_t>(world_chunks.get_chunk_count(), 1),
+               sizeof(Chunk));
+  size_t bytes = 0;
+  size_t kept = 0;
+  for (auto& candidate : prefetch_candidates) {
+    // NOTE: counted before the chunk is created, so a chunk over the budget
+    // never is
+    auto* chunk = world_chunks.find(candidate.pos);
+    size_t estimate = chunk && chunk->is_generated()
+                          ? chunk->get_resident_byte_size()
+                          : average_bytes;
+    if (bytes + estimate > prefetch_bytes_budget) {
+      break;
+    }
+    bytes += estimate;
+    if (!chunk) {
+      chunk = world_chunks
+                  .try_emplace(candidate.pos, candidate.pos, terrain_generator)
+                  .first;
+    }
+    chunk->touch(frame_index);
+    prefetched_chunk_count++;
+    if (chunk->get_state() == ChunkState::PENDING) {
+      candidate.chunk = chunk;
+      prefetch_candidates[kept++] = candidate;
+    }
+  }
+  prefetch_candidates.resize(kept);
+}
 
-    auto* chunk = drawable.chunk;
-    glNamedBufferSubData(vbo, cpu_bytes_allocated,
-                         chunk->get_vertices_byte_size(),
-                         chunk->get_vertices_data());
-    cpu_bytes_allocated += chunk->get_vertices_byte_size();
-    if (cpu_bytes_allocated >= gpu_bytes_allocated) {
-      PANIC("Not enough space allocated for vertices on gpu!\n");
+// prefetching only gets the job slots the chunks in range leave free, and at
+// most prefetch_jobs_per_frame of them
+void ChunkManager::dispatch_generation_jobs() {
+  int jobs_ahead = generation_pool.get_thread_count() * JOBS_AHEAD_PER_WORKER;
+  int free_jobs = jobs_ahead - generation_pool.get_queued_jobs();
+  if (!row_order) {
+    take_highest_priority(generation_candidates, free_jobs);
+  }
+  free_jobs -= (int)generation_candidates.size();
+  // NOTE: already sorted
+  prefetch_candidates.resize(std::clamp(
+      std::min(free_jobs, prefetch_jobs_per_frame), 0,
+      (int)prefetch_candidates.size()));
+
+  for (auto* candidates : {&generation_candidates, &prefetch_candidates}) {
+    for (auto& candidate : *candidates) {
+      auto* chunk = candidate.chunk;
+      chunk->mark_queued();
+      generation_pool.submit([chunk]() { chunk->generate(); });
+    }
+  }
+}
+
+void ChunkManager::dispatch_mesh_jobs() {
+  int jobs_ahead = mesher_count() * JOBS_AHEAD_PER_WORKER;
+  if (!row_order) {
+    take_highest_priority(mesh_candidates,
+                          jobs_ahead - (int)mesh_jobs.size());
+  }
+  for (auto& candidate : mesh_candidates) {
+    auto& chunk = *candidate.chunk;
+    for (const auto& structure : chunk.get_structures()) {
+      place_structure_within_chunk(candidate.pos, structure.x, structure.y,
+                                   structure.z, structure.structure_type);
     }
+    queue_chunk_mesh(candidate.pos, chunk);
   }
 }
 
+// the neighbours' border voxels are copied into the chunk's mesh snapshot here,
+// so the mesher never touches another chunk
+void ChunkManager::queue_chunk_mesh(ChunkPos w, Chunk& chunk) {
+  auto& f_chunk = world_chunks.at(ChunkPos{.x = w.x, .z = w.z + 1});
+  auto& b_chunk = world_chunks.at(ChunkPos{.x = w.x, .z = w.z - 1});
+  auto& l_chunk = world_chunks.at(ChunkPos{.x = w.x - 1, .z = w.z});
+  auto& r_chunk = world_chunks.at(ChunkPos{.x = w.x + 1, .z = w.z});
+  chunk.request_mesh_creation(meshing_mode, f_chunk, b_chunk, l_chunk,
+                              r_chunk);
+  chunk.add_pending_mesh();
+  mesh_jobs.push(&chunk);
+}
+
+// unloads every chunk past the unload ring, and every chunk in the ring that is
+// still PENDING (prefetched for a path the camera turned away from), then
+// evicts the least recently used chunks between the load radius and the unload
+// ring until the loaded chunks fit in resident_bytes_budget. Chunks still in
+// use by a worker are skipped and retried on a later frame
+void ChunkManager::unload_chunks(ChunkPos center) {
+  std::vector<ChunkPos> unneeded;
+  std::vector<std::pair<int64_t, ChunkPos>> eviction_candidates;
+
+  resident_bytes = 0;
+  world_chunks.for_each([&](ChunkPos w, Chunk& chunk) {
+    resident_bytes += chunk.get_resident_byte_size();
+    // inside the load radius (or prefetched) this frame
+    if (chunk.get_last_used_frame() == frame_index) {
+      return;
+    }
+
+    int distance = std::max(std::abs(w.x - center.x), std::abs(w.z - center.z));
+    if (distance > unload_distance ||
+        chunk.get_state() == ChunkState::PENDING) {
+      unneeded.push_back(w);
+    } else {
+      eviction_candidates.emplace_back(chunk.get_last_used_frame(), w);
+    }
+  });
+
+  for (auto w : unneeded) {
+    try_unload_chunk(w);
+  }
+
+  if (resident_bytes <= resident_bytes_budget) {
+    return;
+  }
+  std::sort(eviction_candidates.begin(), eviction_candidates.end(),
+            [](const auto& a, const auto& b) { return a.first < b.first; });
+  for (auto& [last_used, w] : eviction_candidates) {
+    if (resident_bytes <= resident_bytes_budget) {
+      break;
+    }
+    try_unload_chunk(w);
+  }
+}
+
+// NOTE: neighbours being meshed don't matter, they work off a snapshot of this
+// chunk's border voxels
+bool ChunkManager::can_unload_chunk(const Chunk& chunk) {
+  // the generation job or a mesh job still points to it
+  // NOTE: PENDING chunks were never handed out, dropping them is how chunks
+  // that left the load radius before their turn are cancelled
+  return chunk.get_state() == ChunkState::PENDING ||
+         (chunk.is_generated() && !chunk.is_mesh_in_flight());
+}
+
+bool ChunkManager::try_unload_chunk(ChunkPos w) {
+  auto& chunk = world_chunks.at(w);
+  if (!can_unload_chunk(chunk)) {
+    return false;
+  }
+
+  release_chunk_mesh(chunk);
+
+  resident_bytes -= chunk.get_resident_byte_size();
+  world_chunks.erase(w);
+  return true;
+}
+
+// chunks past the new distances are unloaded by unload_chunks as usual
+void ChunkManager::set_view_distance(int view_distance) {
+  if (view_distance == mesh_distance) {
+    return;
+  }
+  mesh_distance = view_distance;
+  load_distance = mesh_distance + load_margin;
+  unload_distance = load_distance + unload_margin;
+  world_chunks.resize(unload_distance);
+  cave_culler = CaveCuller(mesh_distance);
+}
+
+void ChunkManager::update_view_distance(double frame_ms, double busy_ms) {
+  if (!auto_view_distance) {
+    return;
+  }
+  // NOTE: the vbo can always grow to max_gpu_bytes, so only what is in use
+  // counts against it
+  auto stats = ViewDistanceScaler::FrameStats{
+      .frame_ms = frame_ms,
+      .busy_ms = busy_ms,
+      .over_memory_budget =
+          gpu_memory_full || resident_bytes > resident_bytes_budget,
+      .memory_headroom =
+          gpu_allocator.get_bytes_in_use() < max_gpu_bytes * 0.75 &&
+          resident_bytes < resident_bytes_budget * 0.75,
+      .loading = is_loading()};
+  set_view_distance(view_distance_scaler.update(
+      glfwGetTime(), stats, mesh_distance, min_view_distance,
+      max_view_distance));
+}
+
+void ChunkManager::set_max_view_distance(int view_distance) {
+  max_view_distance =
+      std::clamp(view_distance, min_view_distance, MAX_VIEW_DISTANCE);
+  // auto scaling clamps it on its next update, and grows back up slowly
+  if (!auto_view_distance) {
+    set_view_distance(max_view_distance);
+  }
+}
+
+void ChunkManager::set_auto_view_distance(bool enabled) {
+  auto_view_distance = enabled;
+  if (!auto_view_distance) {
+    set_view_distance(max_view_distance);
+  }
+}
+
+void ChunkManager::set_meshing_mode(MeshingMode meshing_mode) {
+  this->meshing_mode = meshing_mode;
+  // so the average mesh time shown is for the new mode
+  mesh_time_ns = 0;
+  meshes_built = 0;
+
+  // remesh every chunk that already has a mesh, the old mesh keeps being drawn
+  // until the new one is uploaded
+  world_chunks.for_each([&](ChunkPos w, Chunk& chunk) {
+    if (chunk.get_state() == ChunkState::READY && neighbours_generated(w)) {
+      queue_chunk_mesh(w, chunk);
+    }
+  });
+}
+
 void ChunkManager::render_chunks() {
   manage_chunks(player_camera.get_player_pos());
 
@@ -191,14 +851,177 @@ void ChunkManager::render_chunks() {
   glBindBuffer(GL_ARRAY_BUFFER, vbo);
   glBindTextureUnit(0, tex_atlas);
 
-  std::vector<GLsizei> first;
-  std::vector<GLsizei> count;
+  update_draw_commands();
+  glBindBuffer(GL_DRAW_INDIRECT_BUFFER, draw_commands_buffer);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, chunk_origins_ssbo);
+  glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_SHORT, nullptr,
+                              draw_commands.size(), 0);
+}
+
+// adds sections that became visible, frees the slots of those that were
+// culled, and uploads only the slots that changed. Sections whose mesh was
+// uploaded or released since last frame lost their slot in release_chunk_mesh
+void ChunkManager::update_draw_commands() {
   for (auto& drawable : render_list) {
-    first.push_back(drawable.offset);
-    count.push_back((drawable.chunk->get_vertices_byte_size() / sizeof(float)) /
-                    attributes_per_vertice);
+    auto& section = drawable.chunk->get_section(drawable.section);
+    // remeshed empty since it was culled this frame
+    if (section.gpu_vertex_count == 0) {
+      continue;
+    }
+    section.drawn_frame = frame_index;
+    if (section.draw_slot < 0) {
+      add_draw(drawable);
+    }
   }
-  glMultiDrawArrays(GL_TRIANGLES, first.data(), count.data(), first.size());
+  // NOTE: backwards, so the slot moved into a freed one was already kept
+  for (int slot = draw_slots.size() - 1; slot >= 0; slot--) {
+    auto& drawable = draw_slots[slot];
+    if (drawable.chunk->get_section(drawable.section).drawn_frame !=
+        frame_index) {
+      remove_draw(slot);
+    }
+  }
+
+  if (reserve_draw_buffers(draw_commands.size())) {
+    dirty_slots_begin = 0;
+    dirty_slots_end = draw_commands.size();
+  }
+  dirty_slots_end = std::min<int>(dirty_slots_end, draw_commands.size());
+  if (dirty_slots_begin >= dirty_slots_end) {
+    return;
+  }
+  // NOTE: origins are indexed by gl_DrawID, so they have to be in draw order
+  int count = dirty_slots_end - dirty_slots_begin;
+  glNamedBufferSubData(
+      draw_commands_buffer,
+      dirty_slots_begin * sizeof(DrawElementsIndirectCommand),
+      count * sizeof(DrawElementsIndirectCommand),
+      draw_commands.data() + dirty_slots_begin);
+  glNamedBufferSubData(chunk_origins_ssbo,
+                       dirty_slots_begin * sizeof(ChunkOrigin),
+                       count * sizeof(ChunkOrigin),
+                       draw_origins.data() + dirty_slots_begin);
+  dirty_slots_begin = 0;
+  dirty_slots_end = 0;
+}
+
+void ChunkManager::add_draw(const ChunkDrawData& drawable) {
+  auto* chunk = drawable.chunk;
+  auto& section = chunk->get_section(drawable.section);
+  section.draw_slot = draw_slots.size();
+  draw_slots.push_back(drawable);
+  // every draw starts at index 0 of quad_ebo, the base vertex picks out the
+  // section's vertices
+  draw_commands.push_back(DrawElementsIndirectCommand{
+      .count = (GLuint)section.gpu_vertex_count / 4 * 6,
+      .instance_count = 1,
+      .first_index = 0,
+      .base_vertex =
+          (GLint)(section.gpu_allocation->offset / sizeof(PackedVertex)),
+      .base_instance = 0,
+  });
+  draw_origins.push_back(
+      ChunkOrigin{.x = chunk->get_x_offset(), .z = chunk->get_z_offset()});
+  mark_draw_dirty(section.draw_slot);
+}
+
+// the last slot takes the freed one's place
+void ChunkManager::remove_draw(int slot) {
+  auto& removed = draw_slots[slot];
+  removed.chunk->get_section(removed.section).draw_slot = -1;
+
+  int last = draw_slots.size() - 1;
+  if (slot != last) {
+    draw_slots[slot] = draw_slots[last];
+    draw_commands[slot] = draw_commands[last];
+    draw_origins[slot] = draw_origins[last];
+    auto& moved = draw_slots[slot];
+    moved.chunk->get_section(moved.section).draw_slot = slot;
+    mark_draw_dirty(slot);
+  }
+  draw_slots.pop_back();
+  draw_commands.pop_back();
+  draw_origins.pop_back();
+}
+
+void ChunkManager::mark_draw_dirty(int slot) {
+  if (dirty_slots_begin >= dirty_slots_end) {
+    dirty_slots_begin = slot;
+    dirty_slots_end = slot + 1;
+    return;
+  }
+  dirty_slots_begin = std::min(dirty_slots_begin, slot);
+  dirty_slots_end = std::max(dirty_slots_end, slot + 1);
+}
+
+// (re)creates the draw buffers with room for at least draws draws, growing
+// geometrically so a widening view doesn't reallocate them every frame.
+// Returns whether they were recreated (and are empty)
+bool ChunkManager::reserve_draw_buffers(int draws) {
+  if (draws <= draw_buffer_capacity) {
+    return false;
+  }
+  draw_buffer_capacity = std::max({draws, draw_buffer_capacity * 2, 1024});
+
+  glDeleteBuffers(1, &draw_commands_buffer);
+  glDeleteBuffers(1, &chunk_origins_ssbo);
+  glCreateBuffers(1, &draw_commands_buffer);
+  glNamedBufferStorage(draw_commands_buffer,
+                       draw_buffer_capacity *
+                           sizeof(DrawElementsIndirectCommand),
+                       nullptr, GL_DYNAMIC_STORAGE_BIT);
+  glCreateBuffers(1, &chunk_origins_ssbo);
+  glNamedBufferStorage(chunk_origins_ssbo,
+                       draw_buffer_capacity * sizeof(ChunkOrigin), nullptr,
+                       GL_DYNAMIC_STORAGE_BIT);
+  return true;
+}
+
+// compares the palette compressed voxels against a flat array of voxels
+VoxelMemoryStats ChunkManager::get_voxel_memory_stats() const {
+  VoxelMemoryStats stats{.palette_bytes = 0, .estimated_flat_bytes = 0};
+  world_chunks.for_each([&](ChunkPos, const Chunk& chunk) {
+    if (chunk.is_generated()) {
+      stats.palette_bytes += chunk.get_voxels_byte_size();
+      stats.estimated_flat_bytes +=
+          CHUNK_WIDTH * CHUNK_DEPTH * CHUNK_HEIGHT * sizeof(Voxel);
+    }
+  });
+  return stats;
+}
+
+double ChunkManager::get_average_mesh_time() const {
+  int count = meshes_built.load(std::memory_order_relaxed);
+  if (count == 0) {
+    return 0.0;
+  }
+  return mesh_time_ns.load(std::memory_order_relaxed) / 1e6 / count;
+}
+
+LoadLatencyStats ChunkManager::get_load_latency_stats() const {
+  LoadLatencyStats stats{.average_ms = 0.0, .worst_ms = 0.0};
+  int count = std::min(load_latency_count, LOAD_LATENCY_SAMPLES);
+  if (count == 0) {
+    return stats;
+  }
+  for (auto i = 0; i < count; i++) {
+    stats.average_ms += load_latencies[i];
+    stats.worst_ms = std::max(stats.worst_ms, load_latencies[i]);
+  }
+  stats.average_ms /= count;
+  return stats;
+}
+
+LoadLatencyStats ChunkManager::get_total_load_latency_stats() const {
+  return LoadLatencyStats{
+      .average_ms = load_latency_total_ms / std::max(load_latency_count, 1),
+      .worst_ms = load_latency_worst_ms};
+}
+
+void ChunkManager::reset_load_latency_stats() {
+  load_latency_count = 0;
+  load_latency_total_ms = 0.0;
+  load_latency_worst_ms = 0.0;
 }
 
 uint32_t ChunkManager::random_seed() {
@@ -206,6 +1029,5 @@ uint32_t ChunkManager::random_seed() {
   std::random_device rand_dev;
   std::mt19937 rand_engine(rand_dev());
   uint32_t x = unif(rand_engine) * 0xffff'ffff;
-  PRINT("[DEBUG] seed: {}\n", x);
   return x;
 }
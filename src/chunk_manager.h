@@ -1,7 +1,17 @@
 #pragma once
+#include "cave_culler.h"
 #include "chunk.h"
+#include "chunk_grid.h"
+#include "engine_config.h"
 #include "frustum.h"
+#include "gpu_allocator.h"
+#include "job_queue.h"
+#include "occlusion_culler.h"
 #include "player_camera.h"
+#include "staging_ring.h"
+#include "terrain_generator.h"
+#include "thread_pool.h"
+#include "view_distance_scaler.h"
 #include <deque>
 #include <thread>
 
@@ -11,14 +21,72 @@
 
 // The chunk draw process:
 //  N + 1 chunk data generated around the player (once)
+//    - generation jobs run on a work stealing thread pool
 //  N chunk meshes generated around player (once)
-//    - separate thread dedicated to generating this data
-//  Frustum culling to determine visible meshes (per frame)
+//    - mesher threads take jobs from mesh_jobs, and hand finished chunks back
+//      through finished_meshes
+//    - both are handed out nearest first (see get_load_priority), a few jobs
+//      ahead of the workers, so chunks in front of the camera go first
+//      (or all at once in row order, see row_order)
+//    - chunks on the camera's predicted path are generated ahead of time,
+//      past the load radius, with the jobs left over
+//  Finished meshes uploaded into a range of the shared vbo (once)
+//    - meshers write them into a persistently mapped staging ring, the render
+//      thread copies at most UPLOAD_BYTES_PER_FRAME a frame into the vbo
+//  Chunks past the unload ring, or least recently used ones once over the
+//  resident memory budget, are unloaded (per frame)
+//  The view distance is scaled to the frame time and memory budgets (per
+//  frame)
+//  Frustum culling to determine visible chunk sections (per frame)
+//  Cave culling of those the camera can't see through open voxels (per frame)
+//  Occlusion culling of those against the ground of nearby chunks (per frame)
+//    - on the occlusion culler's thread, while meshes are uploaded
 //  Render visible meshes (per frame)
 
+// one draw per non empty chunk section
 struct ChunkDrawData {
-  int offset;
   Chunk* chunk;
+  int section;
+};
+
+struct VoxelMemoryStats {
+  size_t palette_bytes;
+  // what the same chunks would take as flat arrays of voxels, worked out from
+  // the chunk count rather than measured
+  size_t estimated_flat_bytes;
+};
+
+// time from a chunk entering the frustum to its mesh being uploaded, over the
+// last LOAD_LATENCY_SAMPLES chunks
+struct LoadLatencyStats {
+  double average_ms;
+  double worst_ms;
+};
+
+// a chunk waiting for a generation or mesh job, lower priority goes first
+struct LoadCandidate {
+  float priority;
+  ChunkPos pos;
+  Chunk* chunk;
+};
+
+// matches the ivec2 layout of the chunk_origins ssbo in chunk_vert
+struct ChunkOrigin {
+  GLint x;
+  GLint z;
+
+  bool operator==(const ChunkOrigin&) const = default;
+};
+
+// layout glMultiDrawElementsIndirect reads from GL_DRAW_INDIRECT_BUFFER
+struct DrawElementsIndirectCommand {
+  GLuint count;
+  GLuint instance_count;
+  GLuint first_index;
+  GLint base_vertex;
+  GLuint base_instance;
+
+  bool operator==(const DrawElementsIndirectCommand&) const = default;
 };
 
 class ChunkManager {
@@ -27,26 +95,173 @@ private:
 
   GLuint vao;
   GLuint vbo;
-  int cpu_bytes_allocated = 0;
-  int gpu_bytes_allocated = 1024 * 1024 * 100;
+  // QUAD_INDICES repeated for MAX_QUADS_PER_SECTION quads, shared by every
+  // section's draw through its base vertex
+  GLuint quad_ebo;
+  // one command (and chunk origin) per drawn section, in no particular order.
+  // A section keeps its slot while it stays drawn: slots are only added when
+  // a section becomes visible, and freed (by moving the last slot in) when it
+  // is culled or its mesh released, so a still camera touches neither buffer
+  GLuint draw_commands_buffer = 0;
+  GLuint chunk_origins_ssbo = 0;
+  int draw_buffer_capacity = 0;
+  std::vector<DrawElementsIndirectCommand> draw_commands;
+  std::vector<ChunkOrigin> draw_origins;
+  // the section in each slot
+  std::vector<ChunkDrawData> draw_slots;
+  // slots changed since the last upload, empty when begin >= end
+  int dirty_slots_begin = 0;
+  int dirty_slots_end = 0;
+  // the vbo is grown (up to max_gpu_bytes) when a mesh doesn't fit
+  int gpu_bytes_allocated;
+  int max_gpu_bytes;
+  // a mesh didn't fit even at max_gpu_bytes this frame
+  bool gpu_memory_full = false;
   ShaderProgram shader_program;
-  int attributes_per_vertice = 5;
+  GpuAllocator gpu_allocator;
+
+  // finished meshes past this are left for the next frames, so a burst of
+  // meshes (eg: after teleporting) can't stall a single frame
+  static constexpr int UPLOAD_BYTES_PER_FRAME = 4 * 1024 * 1024;
+  static_assert(UPLOAD_BYTES_PER_FRAME >= SECTIONS_PER_CHUNK *
+                                              MAX_QUADS_PER_SECTION * 4 *
+                                              (int)sizeof(PackedVertex),
+                "the largest chunk mesh must fit in a frame's upload budget");
+  // meshers run up to a few frames of uploads ahead before waiting for room
+  static constexpr int STAGING_RING_BYTES = 4 * UPLOAD_BYTES_PER_FRAME;
+  StagingRing staging_ring{STAGING_RING_BYTES};
+  // finished meshes waiting for upload budget, oldest first
+  std::deque<Chunk*> pending_uploads;
 
   GLuint tex_atlas;
-  siv::PerlinNoise perlin_noise;
+  TerrainGenerator terrain_generator;
+
+  // chunks are meshed (and drawn) within mesh_distance of the camera's chunk,
+  // generated within load_distance (at least one more, so every meshed chunk
+  // has its neighbours) and only unloaded past unload_distance, so moving
+  // back and forth over a chunk border doesn't regenerate the same chunks
+  int mesh_distance;
+  int load_distance;
+  int unload_distance;
+  int load_margin;
+  int unload_margin;
+  // auto scaling keeps mesh_distance between these
+  int min_view_distance;
+  int max_view_distance;
+  bool auto_view_distance;
+  ViewDistanceScaler view_distance_scaler;
+  MeshingMode meshing_mode = MeshingMode::BINARY;
+
+  // chunks inside the hysteresis ring (between the load and unload distance)
+  // are evicted least recently used first once the cpu memory held by loaded
+  // chunks goes over this
+  size_t resident_bytes_budget;
+  size_t resident_bytes = 0;
+  int64_t frame_index = 0;
 
   ChunkPos old_world_pos;
-  std::unordered_map<ChunkPos, Chunk> world_chunks;
+
+  // jobs handed to the workers are out of reach of the load order, so only
+  // this many per worker are queued ahead of them
+  static constexpr int JOBS_AHEAD_PER_WORKER = 4;
+  // how much facing (and heading towards, at full speed) a chunk shrinks its
+  // load priority
+  static constexpr float FACING_WEIGHT = 0.5f;
+  static constexpr float HEADING_WEIGHT = 0.25f;
+  static constexpr float FULL_SPEED = 20.0f;
+  // rebuilt every frame from the chunks in range, so chunks that left it are
+  // never handed out
+  std::vector<LoadCandidate> generation_candidates;
+  std::vector<LoadCandidate> mesh_candidates;
+  // hands every candidate out as soon as it's found, in dx/dz loop order, like
+  // before jobs were ranked. Only there to compare load latencies against
+  bool row_order = false;
+
+  // see prefetch_chunks
+  static constexpr float PREFETCH_SECONDS = 2.0f;
+  static constexpr int PREFETCH_STEPS = 8;
+  static constexpr float PREFETCH_MIN_SPEED = 1.0f;
+  bool prefetch = true;
+  size_t prefetch_bytes_budget = 32 * 1024 * 1024;
+  int prefetch_jobs_per_frame = 2;
+  std::vector<LoadCandidate> prefetch_candidates;
+  int prefetched_chunk_count = 0;
+  // chunks in range and in the frustum without a mesh, ie: holes in the world
+  int missing_chunk_count = 0;
+  // xz only, camera_velocity is smoothed over a few frames
+  glm::vec3 camera_forward{0.0f};
+  glm::vec3 camera_velocity{0.0f};
+  glm::vec3 last_camera_pos{0.0f};
+  double last_frame_time = -1.0;
+
+  static constexpr int LOAD_LATENCY_SAMPLES = 64;
+  std::array<double, LOAD_LATENCY_SAMPLES> load_latencies{};
+  int load_latency_count = 0;
+  // over every chunk since reset_load_latency_stats
+  double load_latency_total_ms = 0.0;
+  double load_latency_worst_ms = 0.0;
+  // NOTE: spans the unload ring, so only chunks waiting to be unloaded end up
+  // in its fallback map
+  ChunkGrid world_chunks{unload_distance};
   std::vector<ChunkDrawData> visible_list;
+  // bounding boxes of visible_list, and the frustum test's result bitmask
+  BoundingBoxList visible_boxes;
+  std::vector<uint64_t> in_frustum;
+  // bounding boxes of render_list before occlusion culling
+  BoundingBoxList in_frustum_boxes;
+  size_t frustum_section_count = 0;
+  // of those, the ones reachable by the cave culler
+  size_t connected_section_count = 0;
+  // chunks in range without an uploaded, up to date mesh
+  int chunks_loading = 0;
+
+  bool cave_culling = true;
+  CaveCuller cave_culler{mesh_distance};
+
+  bool occlusion_culling = true;
+  // how long the render thread waits for the occlusion pass past the uploads
+  std::chrono::microseconds occlusion_budget{2000};
+  // chunks further than this are too small on screen to be worth rasterizing
+  int occluder_distance = 8;
+  std::vector<BoundingBox> occluders;
+  OcclusionCuller occlusion_culler;
+  bool occlusion_applied = false;
   std::vector<ChunkDrawData> render_list;
-  std::vector<WorldStructure> structures_to_be_generated;
 
-  std::thread mesh_gen_thread;
-  std::deque<Chunk*> mesh_gen_queue;
+  std::vector<std::thread> mesh_workers;
+  JobQueue<Chunk*> mesh_jobs;
+  JobQueue<Chunk*> finished_meshes;
+  std::atomic<int64_t> mesh_time_ns = 0;
+  std::atomic<int> meshes_built = 0;
 
-  void manage_chunks(glm::vec3 pos);
+  // NOTE: declared after world_chunks so it is destroyed (and joined) before
+  // the chunks its jobs point to
+  ThreadPool generation_pool;
 
-  int view_distance = 12;
+  static int mesher_count();
+  void manage_chunks(glm::vec3 pos);
+  bool neighbours_generated(ChunkPos w);
+  void update_camera_motion(glm::vec3 pos);
+  float get_load_priority(ChunkPos w, glm::vec3 pos) const;
+  void prefetch_chunks(ChunkPos center, glm::vec3 pos);
+  void dispatch_generation_jobs();
+  void dispatch_mesh_jobs();
+  void queue_chunk_mesh(ChunkPos w, Chunk& chunk);
+  void stage_mesh(Chunk& chunk);
+  void upload_pending_meshes();
+  bool upload_chunk_mesh(Chunk& chunk);
+  bool grow_vertex_buffer(int bytes);
+  void release_chunk_mesh(Chunk& chunk);
+  void add_occluder(const Chunk& chunk, glm::vec3 camera_pos);
+  void update_draw_commands();
+  void add_draw(const ChunkDrawData& drawable);
+  void remove_draw(int slot);
+  void mark_draw_dirty(int slot);
+  bool reserve_draw_buffers(int draws);
+  void unload_chunks(ChunkPos center);
+  bool can_unload_chunk(const Chunk& chunk);
+  bool try_unload_chunk(ChunkPos w);
+  void set_view_distance(int view_distance);
 
   static uint32_t random_seed();
 
@@ -69,6 +284,174 @@ private:
   }
 
 public:
-  ChunkManager(PlayerCamera& player_camera);
+  // a random seed is picked when none is given
+  ChunkManager(PlayerCamera& player_camera, std::optional<uint32_t> seed,
+               const EngineConfig& config);
+  ~ChunkManager();
+  ChunkManager(const ChunkManager&) = delete;
+  ChunkManager& operator=(const ChunkManager&) = delete;
+
   void render_chunks();
+  void set_meshing_mode(MeshingMode meshing_mode);
+  // scales the view distance to the last frame's times, when auto scaling
+  void update_view_distance(double frame_ms, double busy_ms);
+
+  // the view distance auto scaling goes up to, or the one used without it
+  void set_max_view_distance(int view_distance);
+
+  [[nodiscard]] int get_max_view_distance() const {
+    return max_view_distance;
+  }
+
+  [[nodiscard]] int get_min_view_distance() const {
+    return min_view_distance;
+  }
+
+  void set_auto_view_distance(bool enabled);
+
+  [[nodiscard]] bool is_auto_view_distance() const {
+    return auto_view_distance;
+  }
+
+  [[nodiscard]] int get_view_distance() const {
+    return mesh_distance;
+  }
+
+  [[nodiscard]] int get_load_distance() const {
+    return load_distance;
+  }
+
+  [[nodiscard]] int get_unload_distance() const {
+    return unload_distance;
+  }
+
+  [[nodiscard]] const ViewDistanceScaler& get_view_distance_scaler() const {
+    return view_distance_scaler;
+  }
+
+  [[nodiscard]] MeshingMode get_meshing_mode() const {
+    return meshing_mode;
+  }
+
+  [[nodiscard]] uint32_t get_seed() const {
+    return terrain_generator.get_seed();
+  }
+
+  void set_cave_culling(bool enabled) {
+    cave_culling = enabled;
+  }
+
+  [[nodiscard]] bool is_cave_culling() const {
+    return cave_culling;
+  }
+
+  void set_occlusion_culling(bool enabled) {
+    occlusion_culling = enabled;
+  }
+
+  [[nodiscard]] bool is_occlusion_culling() const {
+    return occlusion_culling;
+  }
+
+  void set_occlusion_budget(std::chrono::microseconds budget) {
+    occlusion_budget = budget;
+  }
+
+  // whether this frame's occlusion pass finished within budget
+  [[nodiscard]] bool is_occlusion_applied() const {
+    return occlusion_applied;
+  }
+
+  // in ms, of the last occlusion pass that finished
+  [[nodiscard]] double get_occlusion_pass_time() const {
+    return occlusion_culler.get_pass_time();
+  }
+
+  // every chunk in view has its mesh uploaded
+  [[nodiscard]] bool is_loading() const {
+    return chunks_loading > 0 || !pending_uploads.empty();
+  }
+
+  [[nodiscard]] int get_gpu_bytes_in_use() const {
+    return gpu_allocator.get_bytes_in_use();
+  }
+
+  [[nodiscard]] int get_gpu_bytes_allocated() const {
+    return gpu_bytes_allocated;
+  }
+
+  void set_prefetch(bool enabled) {
+    prefetch = enabled;
+  }
+
+  [[nodiscard]] bool is_prefetch() const {
+    return prefetch;
+  }
+
+  void set_row_order(bool enabled) {
+    row_order = enabled;
+  }
+
+  [[nodiscard]] bool is_row_order() const {
+    return row_order;
+  }
+
+  // caps the memory held by prefetched chunks, and the generation jobs they
+  // take a frame
+  void set_prefetch_budget(size_t bytes, int jobs_per_frame) {
+    prefetch_bytes_budget = bytes;
+    prefetch_jobs_per_frame = jobs_per_frame;
+  }
+
+  [[nodiscard]] int get_prefetched_chunk_count() const {
+    return prefetched_chunk_count;
+  }
+
+  [[nodiscard]] int get_missing_chunk_count() const {
+    return missing_chunk_count;
+  }
+
+  void set_resident_bytes_budget(size_t bytes) {
+    resident_bytes_budget = bytes;
+  }
+
+  [[nodiscard]] size_t get_resident_bytes() const {
+    return resident_bytes;
+  }
+
+  [[nodiscard]] size_t get_resident_chunk_count() const {
+    return world_chunks.get_chunk_count();
+  }
+
+  // sections with a mesh in range, and the ones of those that were drawn
+  [[nodiscard]] size_t get_meshed_section_count() const {
+    return visible_list.size();
+  }
+
+  [[nodiscard]] size_t get_frustum_section_count() const {
+    return frustum_section_count;
+  }
+
+  [[nodiscard]] size_t get_connected_section_count() const {
+    return connected_section_count;
+  }
+
+  [[nodiscard]] size_t get_drawn_section_count() const {
+    return render_list.size();
+  }
+
+  [[nodiscard]] size_t get_pending_upload_count() const {
+    return pending_uploads.size();
+  }
+
+  [[nodiscard]] VoxelMemoryStats get_voxel_memory_stats() const;
+  // in ms, averaged over every mesh built so far
+  [[nodiscard]] double get_average_mesh_time() const;
+  [[nodiscard]] LoadLatencyStats get_load_latency_stats() const;
+  // every chunk since the last reset, instead of the last LOAD_LATENCY_SAMPLES
+  [[nodiscard]] LoadLatencyStats get_total_load_latency_stats() const;
+  [[nodiscard]] int get_load_latency_count() const {
+    return load_latency_count;
+  }
+  void reset_load_latency_stats();
 };
@@ -61,6 +61,12 @@ Window::~Window() {
   ImGui::DestroyContext();
 }
 
+bool Window::key_just_pressed(int key) {
+  bool was_held = keys_held[key];
+  keys_held[key] = key_pressed(key);
+  return keys_held[key] && !was_held;
+}
+
 void Window::setup_imgui() {
   // Setup Dear ImGui context
   IMGUI_CHECKVERSION();
@@ -3,6 +3,7 @@
 #include "imgui.h"
 #include "imgui_impl_glfw.h"
 #include "imgui_impl_opengl3.h"
+#include <array>
 #include <glad/glad.h>
 // glfw3 has to be included after glad
 #include <GLFW/glfw3.h>
@@ -16,6 +17,7 @@ private:
   const char* window_name;
   GLFWwindow* window;
   bool is_frame_limited;
+  std::array<bool, GLFW_KEY_LAST + 1> keys_held{};
 
   void setup_imgui();
 
@@ -54,6 +56,9 @@ public:
     return glfwGetKey(window, key) == GLFW_RELEASE;
   };
 
+  // only true on the frame the key goes down, for toggles
+  bool key_just_pressed(int key);
+
   static void imgui_new_frame();
   static void imgui_end_frame();
 };
@@ -0,0 +1,93 @@
+#include "engine_config.h"
+#include "common.h"
+#include <cstdint>
+#include <fstream>
+#include <sstream>
+#include <type_traits>
+
+// the most resident_megabytes can be without the byte count overflowing
+static constexpr size_t MAX_RESIDENT_MEGABYTES = SIZE_MAX / (1024 * 1024);
+
+template <typename T>
+static void parse_value(std::istringstream& line, T& value,
+                        const std::string& key, const std::string& path) {
+  // NOTE: streams read "-1" into unsigned types by wrapping it around
+  bool negative = std::is_unsigned_v<T> && (line >> std::ws).peek() == '-';
+  if (negative || !(line >> value) || !(line >> std::ws).eof()) {
+    PANIC("Malformed value for {} in config: {}\n", key, path);
+  }
+}
+
+EngineConfig load_engine_config(const std::string& path) {
+  EngineConfig config;
+  std::ifstream file(path);
+  if (!file) {
+    PRINT("[DEBUG] No config at {}, using defaults\n", path);
+    return config;
+  }
+
+  std::string text;
+  while (std::getline(file, text)) {
+    text = text.substr(0, text.find('#'));
+    std::istringstream line(text);
+    std::string key;
+    if (!(line >> key)) {
+      continue;
+    }
+
+    if (key == "view_distance") {
+      parse_value(line, config.view_distance, key, path);
+    } else if (key == "min_view_distance") {
+      parse_value(line, config.min_view_distance, key, path);
+    } else if (key == "load_margin") {
+      parse_value(line, config.load_margin, key, path);
+    } else if (key == "unload_margin") {
+      parse_value(line, config.unload_margin, key, path);
+    } else if (key == "auto_view_distance") {
+      parse_value(line, config.auto_view_distance, key, path);
+    } else if (key == "smooth_terrain") {
+      parse_value(line, config.smooth_terrain, key, path);
+    } else if (key == "target_frame_ms") {
+      parse_value(line, config.target_frame_ms, key, path);
+    } else if (key == "resident_megabytes") {
+      parse_value(line, config.resident_megabytes, key, path);
+    } else if (key == "gpu_megabytes") {
+      parse_value(line, config.gpu_megabytes, key, path);
+    } else if (key == "max_gpu_megabytes") {
+      parse_value(line, config.max_gpu_megabytes, key, path);
+    } else {
+      PANIC("Unknown key {} in config: {}\n", key, path);
+    }
+  }
+
+  if (config.min_view_distance < 1 ||
+      config.min_view_distance > config.view_distance ||
+      config.view_distance > MAX_VIEW_DISTANCE) {
+    PANIC("View distances must be 1 <= min_view_distance <= view_distance <= "
+          "{} in config: {}\n",
+          MAX_VIEW_DISTANCE, path);
+  }
+  if (config.load_margin < 1 || config.unload_margin < 0) {
+    PANIC("load_margin must be at least 1, unload_margin at least 0 in "
+          "config: {}\n",
+          path);
+  }
+  if (config.target_frame_ms <= 0.0) {
+    PANIC("target_frame_ms must be positive in config: {}\n", path);
+  }
+  if (config.resident_megabytes < 1 ||
+      config.resident_megabytes > MAX_RESIDENT_MEGABYTES) {
+    PANIC("resident_megabytes must be 1 <= resident_megabytes <= {} in "
+          "config: {}\n",
+          MAX_RESIDENT_MEGABYTES, path);
+  }
+  // NOTE: gpu offsets are ints
+  if (config.gpu_megabytes < 1 ||
+      config.gpu_megabytes > config.max_gpu_megabytes ||
+      config.max_gpu_megabytes > 2047) {
+    PANIC("Gpu budgets must be 1 <= gpu_megabytes <= max_gpu_megabytes <= "
+          "2047 in config: {}\n",
+          path);
+  }
+  return config;
+}
@@ -0,0 +1,37 @@
+#pragma once
+#include <cstddef>
+#include <string>
+
+// the largest view distance the slider (and config) allow
+static constexpr int MAX_VIEW_DISTANCE = 32;
+
+// settings read at startup, so one binary can be tuned per machine.
+// Saved as text: one "key value" pair per line, # starts a comment, keys
+// that aren't given keep the defaults below
+struct EngineConfig {
+  // chunks meshed (and drawn) around the camera, the most auto scaling picks
+  int view_distance = 12;
+  // auto scaling never goes below this
+  int min_view_distance = 4;
+  // chunks are generated this far past the view distance, at least 1 so
+  // every meshed chunk has its neighbours
+  int load_margin = 1;
+  // and unloaded this far past the load distance
+  int unload_margin = 2;
+  bool auto_view_distance = true;
+  // smooth (monotone cubic) height curve instead of straight segments.
+  // Changes the terrain of every seed
+  bool smooth_terrain = false;
+  // auto scaling steps down when frames take longer than this
+  double target_frame_ms = 1000.0 / 60.0;
+  // cpu memory held by loaded chunks
+  size_t resident_megabytes = 256;
+  // the mesh buffer starts at gpu_megabytes and grows up to
+  // max_gpu_megabytes
+  int gpu_megabytes = 100;
+  int max_gpu_megabytes = 1024;
+};
+
+// defaults if the file doesn't exist, panics if it is malformed or out of
+// range
+EngineConfig load_engine_config(const std::string& path);
@@ -1,6 +1,16 @@
 #include "frustum.h"
 
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define FRUSTUM_AVX
+#include <immintrin.h>
+#endif
+
 Frustum::Frustum() {
+#ifdef FRUSTUM_AVX
+  use_avx = __builtin_cpu_supports("avx");
+#else
+  use_avx = false;
+#endif
 }
 
 // must be called every frame before performing frustum culling
@@ -47,7 +57,7 @@ void Frustum::create_frustum_from_camera(const glm::mat4& comboMatrix) {
 }
 
 // true = inside frustum
-bool Frustum::test_point(const glm::vec3& point) {
+bool Frustum::test_point(const glm::vec3& point) const {
   for (auto& plane : planes) {
     if (plane.distance_to_point(point) < 0) {
       return false;
@@ -56,7 +66,7 @@ bool Frustum::test_point(const glm::vec3& point) {
   return true;
 }
 
-bool Frustum::test_bounding_box(const BoundingBox& bounding_box) {
+bool Frustum::test_bounding_box(const BoundingBox& bounding_box) const {
   for (auto& plane : planes) {
     if (!plane.bounding_box_test(bounding_box)) {
       return false;
@@ -65,6 +75,72 @@ bool Frustum::test_bounding_box(const BoundingBox& bounding_box) {
   return true;
 }
 
+void Frustum::test_bounding_boxes(const BoundingBoxList& boxes,
+                                  std::vector<uint64_t>& visible) const {
+  visible.assign((boxes.size() + 63) / 64, 0);
+  if (use_avx) {
+    test_bounding_boxes_avx(boxes, visible);
+  } else {
+    test_bounding_boxes_scalar(boxes, 0, visible);
+  }
+}
+
+// tests boxes[begin..]
+void Frustum::test_bounding_boxes_scalar(const BoundingBoxList& boxes,
+                                         size_t begin,
+                                         std::vector<uint64_t>& visible) const {
+  for (auto i = begin; i < boxes.size(); i++) {
+    auto bb = boxes.get(i);
+    bool inside = true;
+    for (auto& plane : planes) {
+      inside &= plane.bounding_box_test(bb);
+    }
+    visible[i / 64] |= (uint64_t)inside << (i % 64);
+  }
+}
+
+#ifdef FRUSTUM_AVX
+
+// 8 boxes at a time. A plane's normal picks the same positive vertex corner
+// for every box, so it is just a choice between the min and max arrays
+__attribute__((target("avx"))) void
+Frustum::test_bounding_boxes_avx(const BoundingBoxList& boxes,
+                                 std::vector<uint64_t>& visible) const {
+  size_t n = boxes.size() / 8 * 8;
+  for (size_t i = 0; i < n; i += 8) {
+    __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+    for (auto& plane : planes) {
+      const float* px = plane.a >= 0 ? &boxes.max_x[i] : &boxes.min_x[i];
+      const float* py = plane.b >= 0 ? &boxes.max_y[i] : &boxes.min_y[i];
+      const float* pz = plane.c >= 0 ? &boxes.max_z[i] : &boxes.min_z[i];
+      // ((a * x + b * y) + c * z) + d, like Plane::distance_to_point
+      __m256 distance =
+          _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(plane.a),
+                                      _mm256_loadu_ps(px)),
+                        _mm256_mul_ps(_mm256_set1_ps(plane.b),
+                                      _mm256_loadu_ps(py)));
+      distance = _mm256_add_ps(
+          distance,
+          _mm256_mul_ps(_mm256_set1_ps(plane.c), _mm256_loadu_ps(pz)));
+      distance = _mm256_add_ps(distance, _mm256_set1_ps(plane.d));
+      inside = _mm256_and_ps(
+          inside, _mm256_cmp_ps(distance, _mm256_setzero_ps(), _CMP_GE_OQ));
+    }
+    // i is a multiple of 8, so the 8 bits never straddle two words
+    visible[i / 64] |= (uint64_t)_mm256_movemask_ps(inside) << (i % 64);
+  }
+  test_bounding_boxes_scalar(boxes, n, visible);
+}
+
+#else
+
+void Frustum::test_bounding_boxes_avx(const BoundingBoxList& boxes,
+                                      std::vector<uint64_t>& visible) const {
+  test_bounding_boxes_scalar(boxes, 0, visible);
+}
+
+#endif
+
 /*
 // clang-format off
 auto test = glm::mat4(0, 0, 0, 0,
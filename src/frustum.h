@@ -6,6 +6,7 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
+#include <vector>
 
 // bless
 // https://www.gamedevs.org/uploads/fast-extraction-viewing-frustum-planes-from-world-view-projection-matrix.pdf
@@ -24,30 +25,46 @@ struct Plane {
     return a * point.x + b * point.y + c * point.z + d;
   }
 
-  // tests all 8 bb vertices against the plane
+  // the box is on the inner side of (or crosses) the plane if its corner
+  // furthest along the plane normal, the positive vertex, is
+  // NOTE: that corner's distance is the largest of the 8 corners', so this
+  // agrees with testing every corner
   [[nodiscard]] bool bounding_box_test(const BoundingBox& bb) const {
-    // clang-format off
-    // TODO: http://www.lighthouse3d.com/tutorials/view-frustum-culling/geometric-approach-testing-boxes-ii/
-    glm::vec3 vertices[8] = {
-      glm::vec3(bb.min.x, bb.min.y, bb.min.z),
-      glm::vec3(bb.min.x, bb.min.y, bb.max.z),
-      glm::vec3(bb.max.x, bb.min.y, bb.max.z),
-      glm::vec3(bb.max.x, bb.min.y, bb.min.z),
+    glm::vec3 p_vertex(a >= 0 ? bb.max.x : bb.min.x,
+                       b >= 0 ? bb.max.y : bb.min.y,
+                       c >= 0 ? bb.max.z : bb.min.z);
+    return distance_to_point(p_vertex) >= 0;
+  }
+};
 
-      glm::vec3(bb.min.x, bb.max.y, bb.min.z),
-      glm::vec3(bb.min.x, bb.max.y, bb.max.z),
-      glm::vec3(bb.max.x, bb.max.y, bb.max.z),
-      glm::vec3(bb.max.x, bb.max.y, bb.min.z),
-    };
+// bounding boxes laid out as a structure of arrays, so the frustum can test 8
+// of them at a time
+struct BoundingBoxList {
+  std::vector<float> min_x, min_y, min_z;
+  std::vector<float> max_x, max_y, max_z;
 
-    // clang-format on
-    int intersection_count = 0;
-    for (auto& vertice : vertices) {
-      if (distance_to_point(vertice) >= 0) {
-        intersection_count++;
-      }
+  void clear() {
+    for (auto* v : {&min_x, &min_y, &min_z, &max_x, &max_y, &max_z}) {
+      v->clear();
     }
-    return intersection_count > 0;
+  }
+
+  void push_back(const BoundingBox& bb) {
+    min_x.push_back(bb.min.x);
+    min_y.push_back(bb.min.y);
+    min_z.push_back(bb.min.z);
+    max_x.push_back(bb.max.x);
+    max_y.push_back(bb.max.y);
+    max_z.push_back(bb.max.z);
+  }
+
+  [[nodiscard]] BoundingBox get(size_t i) const {
+    return BoundingBox{.min = glm::vec3(min_x[i], min_y[i], min_z[i]),
+                       .max = glm::vec3(max_x[i], max_y[i], max_z[i])};
+  }
+
+  [[nodiscard]] size_t size() const {
+    return min_x.size();
   }
 };
 
@@ -62,10 +79,22 @@ class Frustum {
   };
 
   Plane planes[6];
+  bool use_avx;
+
+  void test_bounding_boxes_scalar(const BoundingBoxList& boxes, size_t begin,
+                                  std::vector<uint64_t>& visible) const;
+  void test_bounding_boxes_avx(const BoundingBoxList& boxes,
+                               std::vector<uint64_t>& visible) const;
 
 public:
   Frustum();
   void create_frustum_from_camera(const glm::mat4& comboMatrix);
-  bool test_point(const glm::vec3& point);
-  bool test_bounding_box(const BoundingBox& bounding_box);
+  bool test_point(const glm::vec3& point) const;
+  bool test_bounding_box(const BoundingBox& bounding_box) const;
+  // bit i % 64 of visible[i / 64] is set if boxes[i] is inside (or crosses)
+  // the frustum, same result as test_bounding_box on every box apart from
+  // rounding on boxes touching a plane (the compiler may fuse the scalar
+  // path's multiplies and adds)
+  void test_bounding_boxes(const BoundingBoxList& boxes,
+                           std::vector<uint64_t>& visible) const;
 };
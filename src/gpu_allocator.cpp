@@ -0,0 +1,81 @@
+#include "gpu_allocator.h"
+#include "common.h"
+#include <iterator>
+
+GpuAllocator::GpuAllocator(int capacity, int alignment)
+    : capacity(capacity - capacity % alignment), alignment(alignment) {
+  free_ranges.emplace(0, this->capacity);
+}
+
+std::optional<GpuAllocation> GpuAllocator::allocate(int size) {
+  if (size == 0) {
+    return GpuAllocation{.offset = 0, .size = 0};
+  }
+  size = (size + alignment - 1) / alignment * alignment;
+
+  for (auto it = free_ranges.begin(); it != free_ranges.end(); ++it) {
+    auto [offset, range_size] = *it;
+    if (range_size < size) {
+      continue;
+    }
+
+    free_ranges.erase(it);
+    if (range_size > size) {
+      free_ranges.emplace(offset + size, range_size - size);
+    }
+    bytes_in_use += size;
+    return GpuAllocation{.offset = offset, .size = size};
+  }
+  return std::nullopt;
+}
+
+void GpuAllocator::release(const GpuAllocation& allocation) {
+  if (allocation.size == 0) {
+    return;
+  }
+  if (allocation.offset + allocation.size > capacity) {
+    PANIC("Released gpu range is out of bounds!\n");
+  }
+  bytes_in_use -= allocation.size;
+
+  int offset = allocation.offset;
+  int size = allocation.size;
+
+  // merge with the following free range
+  auto next = free_ranges.lower_bound(offset);
+  if (next != free_ranges.end() && next->first == offset + size) {
+    size += next->second;
+    next = free_ranges.erase(next);
+  }
+
+  // merge with the preceding free range
+  if (next != free_ranges.begin()) {
+    auto prev = std::prev(next);
+    if (prev->first + prev->second == offset) {
+      prev->second += size;
+      return;
+    }
+  }
+
+  free_ranges.emplace(offset, size);
+}
+
+void GpuAllocator::grow(int capacity) {
+  capacity -= capacity % alignment;
+  if (capacity <= this->capacity) {
+    return;
+  }
+  int offset = this->capacity;
+  int size = capacity - this->capacity;
+  this->capacity = capacity;
+
+  // merge with a free range running up to the old end
+  if (!free_ranges.empty()) {
+    auto last = std::prev(free_ranges.end());
+    if (last->first + last->second == offset) {
+      last->second += size;
+      return;
+    }
+  }
+  free_ranges.emplace(offset, size);
+}
@@ -0,0 +1,39 @@
+#pragma once
+#include <map>
+#include <optional>
+
+// a byte range within a gpu buffer handed out by a GpuAllocator
+struct GpuAllocation {
+  int offset;
+  int size;
+};
+
+// first-fit free list allocator for sub-ranges of a single gpu buffer.
+// freed ranges are coalesced with their neighbours so that remeshing/unloading
+// chunks doesn't slowly fragment the buffer
+class GpuAllocator {
+private:
+  int capacity;
+  int alignment;
+  int bytes_in_use = 0;
+  // offset -> size, sorted by offset so neighbours can be merged on release
+  std::map<int, int> free_ranges;
+
+public:
+  GpuAllocator(int capacity, int alignment);
+
+  // sizes are rounded up to a multiple of alignment, so every offset handed
+  // out is also a multiple of alignment (eg: the vertex stride)
+  std::optional<GpuAllocation> allocate(int size);
+  void release(const GpuAllocation& allocation);
+  // the buffer was grown to capacity bytes, with its contents kept
+  void grow(int capacity);
+
+  [[nodiscard]] int get_bytes_in_use() const {
+    return bytes_in_use;
+  }
+
+  [[nodiscard]] int get_capacity() const {
+    return capacity;
+  }
+};
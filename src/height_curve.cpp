@@ -0,0 +1,91 @@
+#include "height_curve.h"
+#include "common.h"
+#include <cmath>
+
+HeightCurve::HeightCurve(std::vector<CurvePoint> points,
+                         CurveInterpolation interpolation)
+    : interpolation(interpolation) {
+  std::sort(points.begin(), points.end(),
+            [](const auto& a, const auto& b) { return a.x < b.x; });
+  if (points.size() < 2 || points.front().x != -1.0f ||
+      points.back().x != 1.0f) {
+    PANIC("Height curve must start at x = -1 and end at x = 1!\n");
+  }
+
+  int n = points.size();
+  gradients.resize(n - 1);
+  for (auto k = 0; k < n - 1; k++) {
+    float dx = points[k + 1].x - points[k].x;
+    if (dx <= 0.0f) {
+      PANIC("Height curve control points must have distinct x values!\n");
+    }
+    gradients[k] = (points[k + 1].y - points[k].y) / dx;
+  }
+
+  // tangents at every control point. Linear just uses the secant of the
+  // segment being evaluated, monotone cubic follows Fritsch-Carlson
+  std::vector<float> tangents(n, 0.0f);
+  if (interpolation == CurveInterpolation::MONOTONE_CUBIC) {
+    tangents[0] = gradients[0];
+    tangents[n - 1] = gradients[n - 2];
+    for (auto k = 1; k < n - 1; k++) {
+      // local extrema (and flat spots) get a flat tangent
+      if (gradients[k - 1] * gradients[k] > 0.0f) {
+        tangents[k] = (gradients[k - 1] + gradients[k]) / 2;
+      }
+    }
+
+    // scales tangents down where they would overshoot
+    for (auto k = 0; k < n - 1; k++) {
+      if (gradients[k] == 0.0f) {
+        tangents[k] = 0.0f;
+        tangents[k + 1] = 0.0f;
+        continue;
+      }
+      float a = tangents[k] / gradients[k];
+      float b = tangents[k + 1] / gradients[k];
+      float length = a * a + b * b;
+      if (length > 9.0f) {
+        float tau = 3.0f / std::sqrt(length);
+        tangents[k] = tau * a * gradients[k];
+        tangents[k + 1] = tau * b * gradients[k];
+      }
+    }
+  }
+
+  int k = 0;
+  for (auto i = 0; i <= TABLE_SIZE; i++) {
+    float x = -1.0f + 2.0f * i / TABLE_SIZE;
+    if (interpolation == CurveInterpolation::LINEAR) {
+      // NOTE: a control point right on the step's start begins the next
+      // segment, like evaluate_segment picks
+      while (k < n - 2 && x >= points[k + 1].x) {
+        k++;
+      }
+      if (i < TABLE_SIZE) {
+        segments[i] = k;
+      }
+      continue;
+    }
+    while (k < n - 2 && x > points[k + 1].x) {
+      k++;
+    }
+
+    auto& p0 = points[k];
+    auto& p1 = points[k + 1];
+    float dx = p1.x - p0.x;
+    float t = (x - p0.x) / dx;
+
+    // cubic hermite basis
+    float t2 = t * t;
+    float t3 = t2 * t;
+    float h00 = 2 * t3 - 3 * t2 + 1;
+    float h10 = t3 - 2 * t2 + t;
+    float h01 = -2 * t3 + 3 * t2;
+    float h11 = t3 - t2;
+    table[i] = h00 * p0.y + h10 * dx * tangents[k] + h01 * p1.y +
+               h11 * dx * tangents[k + 1];
+  }
+
+  this->points = std::move(points);
+}
@@ -0,0 +1,64 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <vector>
+
+// x is a noise value in [-1, 1], y the terrain height it maps to
+struct CurvePoint {
+  float x;
+  float y;
+};
+
+enum class CurveInterpolation {
+  LINEAR,         // straight lines between control points
+  MONOTONE_CUBIC, // smooth, never overshoots between control points
+};
+
+// maps noise values to terrain heights. The curve through the control points
+// is built once (per world) and baked into dense lookup tables, so evaluating
+// it is O(1) no matter how many control points there are
+class HeightCurve {
+private:
+  // NOTE: a multiple of 5, so control points at multiples of 0.2 fall on step
+  // boundaries
+  static constexpr int TABLE_SIZE = 1000;
+  CurveInterpolation interpolation;
+  std::vector<CurvePoint> points;
+  std::vector<float> gradients;
+  // LINEAR: the segment each step starts in
+  std::array<int, TABLE_SIZE> segments;
+  // MONOTONE_CUBIC: samples at x = -1 + 2 * i / TABLE_SIZE
+  std::array<float, TABLE_SIZE + 1> table;
+
+  // NOTE: the same arithmetic the straight segments have always been
+  // evaluated with. A lerp between table entries rounds differently, which
+  // moves columns sitting right at a whole height by a block
+  float evaluate_segment(float x, int k) const {
+    // k is only off when the step straddles a control point, or x rounded
+    // across a step boundary. NOTE: x is tested first, k is all over the place
+    // and would make the branches unpredictable
+    while (x < points[k].x && k > 0) {
+      k--;
+    }
+    while (x >= points[k + 1].x && k < (int)points.size() - 2) {
+      k++;
+    }
+    return points[k].y + (x - points[k].x) * gradients[k];
+  }
+
+public:
+  // the first and last control points must sit at x = -1 and x = 1
+  HeightCurve(std::vector<CurvePoint> points, CurveInterpolation interpolation);
+
+  // x is clamped to [-1, 1]
+  float evaluate(float x) const {
+    x = std::clamp(x, -1.0f, 1.0f);
+    float t = (x + 1.0f) * (TABLE_SIZE / 2);
+    int i = std::min((int)t, TABLE_SIZE - 1);
+    if (interpolation == CurveInterpolation::LINEAR) {
+      return evaluate_segment(x, segments[i]);
+    }
+    float f = t - i;
+    return table[i] + (table[i + 1] - table[i]) * f;
+  }
+};
@@ -0,0 +1,62 @@
+#pragma once
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <optional>
+
+// blocking multi producer, multi consumer queue. Consumers sleep in pop()
+// until an item arrives or the queue is closed
+template <typename T>
+class JobQueue {
+private:
+  std::mutex mutex;
+  std::condition_variable cv;
+  std::deque<T> items;
+  bool closed = false;
+
+public:
+  void push(T item) {
+    {
+      std::lock_guard lock(mutex);
+      items.push_back(std::move(item));
+    }
+    cv.notify_one();
+  }
+
+  // returns std::nullopt once the queue has been closed
+  std::optional<T> pop() {
+    std::unique_lock lock(mutex);
+    cv.wait(lock, [&] { return closed || !items.empty(); });
+    if (closed) {
+      return std::nullopt;
+    }
+    T item = std::move(items.front());
+    items.pop_front();
+    return item;
+  }
+
+  // never blocks, for the render thread
+  std::optional<T> try_pop() {
+    std::lock_guard lock(mutex);
+    if (items.empty()) {
+      return std::nullopt;
+    }
+    T item = std::move(items.front());
+    items.pop_front();
+    return item;
+  }
+
+  // wakes up every consumer, remaining items are dropped
+  void close() {
+    {
+      std::lock_guard lock(mutex);
+      closed = true;
+    }
+    cv.notify_all();
+  }
+
+  size_t size() {
+    std::lock_guard lock(mutex);
+    return items.size();
+  }
+};
@@ -1,4 +1,6 @@
 #include "voxel_engine.h"
+#include <charconv>
+#include <string_view>
 
 // Project Description:
 // common/ -> common opengl abstractions and utility macros/functions
@@ -25,7 +27,58 @@ water mesh generation
 also i should probably fix submodules
  */
 
-int main() {
-  auto voxel_engine = VoxelEngine(1400, 1000);
+// usage: voxel_engine [--seed <n>] [--config <path>]
+//                     [--record <path> | --replay <path>] [--realtime]
+//                     [--no-prefetch] [--row-order]
+// NOTE: the config defaults to DEFAULT_CONFIG_PATH, which like the texture
+// atlas is relative to the build directory
+static constexpr const char* DEFAULT_CONFIG_PATH = "../src/assets/engine.cfg";
+
+static EngineOptions parse_options(int argc, char** argv) {
+  EngineOptions options;
+  std::string config_path = DEFAULT_CONFIG_PATH;
+  for (auto i = 1; i < argc; i++) {
+    std::string_view arg = argv[i];
+    if (arg == "--seed" && i + 1 < argc) {
+      std::string_view value = argv[++i];
+      uint32_t seed;
+      auto [end, error] =
+          std::from_chars(value.data(), value.data() + value.size(), seed);
+      if (error != std::errc() || end != value.data() + value.size()) {
+        PANIC("Invalid seed: {}\n", value);
+      }
+      options.seed = seed;
+    } else if (arg == "--config" && i + 1 < argc) {
+      config_path = argv[++i];
+    } else if (arg == "--record" && i + 1 < argc) {
+      options.record_path = argv[++i];
+    } else if (arg == "--replay" && i + 1 < argc) {
+      options.replay = load_camera_path(argv[++i]);
+    } else if (arg == "--realtime") {
+      options.replay_realtime = true;
+    } else if (arg == "--no-prefetch") {
+      options.prefetch = false;
+    } else if (arg == "--row-order") {
+      options.row_order = true;
+    } else {
+      PANIC("Unknown argument: {}\n", arg);
+    }
+  }
+  if (options.record_path && options.replay) {
+    PANIC("Cannot record and replay at the same time!\n");
+  }
+  if (options.replay_realtime && !options.replay) {
+    PANIC("--realtime needs a path to --replay!\n");
+  }
+  options.config = load_engine_config(config_path);
+  // the poses only make sense in the world they were recorded in
+  if (options.replay) {
+    options.seed = options.replay->seed;
+  }
+  return options;
+}
+
+int main(int argc, char** argv) {
+  auto voxel_engine = VoxelEngine(1400, 1000, parse_options(argc, argv));
   voxel_engine.run();
 }
@@ -0,0 +1,434 @@
+#include "occlusion_culler.h"
+#include <algorithm>
+#include <cmath>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define OCCLUSION_AVX
+#include <immintrin.h>
+#endif
+
+// geometry closer to the camera than this (in clip w, ie: view space depth)
+// is clipped away from occluders, occludees reaching it are always visible
+static constexpr float NEAR_W = 0.1f;
+// an occluder has to be this much nearer (relative, in 1 / w) than an
+// occludee's nearest corner to hide it, so faces an occludee shares with an
+// occluder don't hide it through rounding
+static constexpr float DEPTH_BIAS = 1e-3f;
+// half a pixel, plus slack for rounding. A pixel counts as covered by an
+// occluder when its centre is this far inside every edge
+static constexpr float HALF_PIXEL = 0.501f;
+// boxes with a face whose plane passes this close to the camera (in world
+// units) aren't rasterized, the depth over a face seen edge on is too steep
+// to bound
+static constexpr double EDGE_ON_DISTANCE = 1e-3;
+
+// box corners, same numbering as the cube corners in chunk.cpp
+static constexpr int box_corners[8][3] = {
+    {0, 0, 0}, {0, 0, 1}, {1, 0, 1}, {1, 0, 0},
+    {0, 1, 0}, {0, 1, 1}, {1, 1, 1}, {1, 1, 0},
+};
+
+// the 12 edges between them
+static constexpr int box_edges[12][2] = {
+    {0, 1}, {1, 2}, {2, 3}, {3, 0}, {4, 5}, {5, 6},
+    {6, 7}, {7, 4}, {0, 4}, {1, 5}, {2, 6}, {3, 7},
+};
+
+struct ScreenVertex {
+  float x;
+  float y;
+  // 1 / w
+  float depth;
+};
+
+// 1 / w over a plane, as a * x + b * y + c in pixels
+struct DepthPlane {
+  float a;
+  float b;
+  float c;
+};
+
+static ScreenVertex to_screen(const glm::vec4& clip) {
+  float inv_w = 1.0f / clip.w;
+  return ScreenVertex{
+      .x = (clip.x * inv_w * 0.5f + 0.5f) * OcclusionCuller::WIDTH,
+      .y = (clip.y * inv_w * 0.5f + 0.5f) * OcclusionCuller::HEIGHT,
+      .depth = inv_w};
+}
+
+// twice the signed area of abp
+static float edge(const ScreenVertex& a, const ScreenVertex& b, float px,
+                  float py) {
+  return (b.x - a.x) * (py - a.y) - (b.y - a.y) * (px - a.x);
+}
+
+static glm::vec3 get_corner(const BoundingBox& bb, int corner) {
+  return glm::vec3(box_corners[corner][0] ? bb.max.x : bb.min.x,
+                   box_corners[corner][1] ? bb.max.y : bb.min.y,
+                   box_corners[corner][2] ? bb.max.z : bb.min.z);
+}
+
+// counter clockwise (y up) convex hull of points, in place, returns its size
+static int convex_hull(ScreenVertex* points, int count) {
+  std::sort(points, points + count, [](auto& a, auto& b) {
+    return a.x < b.x || (a.x == b.x && a.y < b.y);
+  });
+  ScreenVertex hull[16];
+  int size = 0;
+  // lower half left to right, then upper half right to left
+  for (auto pass = 0; pass < 2; pass++) {
+    int floor = size;
+    for (auto j = 0; j < count; j++) {
+      auto& p = points[pass == 0 ? j : count - 1 - j];
+      while (size >= floor + 2 && edge(hull[size - 2], hull[size - 1], p.x,
+                                       p.y) <= 0) {
+        size--;
+      }
+      hull[size++] = p;
+    }
+    // the last point is the first of the other half
+    size--;
+  }
+  std::copy(hull, hull + size, points);
+  return size;
+}
+
+// out[i] = max(out[i], min over planes of start[j] + step[j] * i) for i in
+// [begin, end)
+static void fill_span(float* out, int begin, int end, const float* start,
+                      const float* step, int plane_count) {
+  for (auto i = begin; i < end; i++) {
+    float z = INFINITY;
+    for (auto j = 0; j < plane_count; j++) {
+      z = std::min(z, start[j] + step[j] * i);
+    }
+    out[i] = std::max(out[i], z);
+  }
+}
+
+// whether any of values[0, count) is at most limit
+static bool any_at_most(const float* values, int count, float limit) {
+  for (auto i = 0; i < count; i++) {
+    if (values[i] <= limit) {
+      return true;
+    }
+  }
+  return false;
+}
+
+#ifdef OCCLUSION_AVX
+
+// the same, 8 pixels at a time
+__attribute__((target("avx"))) static void
+fill_span_avx(float* out, int begin, int end, const float* start,
+              const float* step, int plane_count) {
+  const __m256 lanes = _mm256_setr_ps(0, 1, 2, 3, 4, 5, 6, 7);
+  auto i = begin;
+  for (; i + 8 <= end; i += 8) {
+    __m256 index = _mm256_add_ps(_mm256_set1_ps((float)i), lanes);
+    __m256 z = _mm256_set1_ps(INFINITY);
+    for (auto j = 0; j < plane_count; j++) {
+      z = _mm256_min_ps(z, _mm256_add_ps(_mm256_set1_ps(start[j]),
+                                         _mm256_mul_ps(_mm256_set1_ps(step[j]),
+                                                       index)));
+    }
+    _mm256_storeu_ps(out + i, _mm256_max_ps(_mm256_loadu_ps(out + i), z));
+  }
+  fill_span(out, i, end, start, step, plane_count);
+}
+
+__attribute__((target("avx"))) static bool
+any_at_most_avx(const float* values, int count, float limit) {
+  __m256 limits = _mm256_set1_ps(limit);
+  auto i = 0;
+  for (; i + 8 <= count; i += 8) {
+    __m256 below =
+        _mm256_cmp_ps(_mm256_loadu_ps(values + i), limits, _CMP_LE_OQ);
+    if (_mm256_movemask_ps(below)) {
+      return true;
+    }
+  }
+  return any_at_most(values + i, count - i, limit);
+}
+
+#else
+
+static void fill_span_avx(float* out, int begin, int end, const float* start,
+                          const float* step, int plane_count) {
+  fill_span(out, begin, end, start, step, plane_count);
+}
+
+static bool any_at_most_avx(const float* values, int count, float limit) {
+  return any_at_most(values, count, limit);
+}
+
+#endif
+
+static bool cpu_has_avx() {
+#ifdef OCCLUSION_AVX
+  return __builtin_cpu_supports("avx");
+#else
+  return false;
+#endif
+}
+
+OcclusionCuller::OcclusionCuller()
+    : depth(WIDTH * HEIGHT), use_avx(cpu_has_avx()),
+      worker([this]() { worker_loop(); }) {
+}
+
+OcclusionCuller::~OcclusionCuller() {
+  {
+    std::lock_guard lock(mutex);
+    stopping = true;
+  }
+  cv.notify_all();
+  worker.join();
+}
+
+bool OcclusionCuller::begin_pass(const glm::mat4& view_projection,
+                                 const std::vector<BoundingBox>& occluders,
+                                 const BoundingBoxList& occludees) {
+  {
+    std::lock_guard lock(mutex);
+    if (busy) {
+      return false;
+    }
+    this->view_projection = view_projection;
+    this->occluders = occluders;
+    this->occludees = occludees;
+    busy = true;
+    pass_queued = true;
+  }
+  cv.notify_all();
+  return true;
+}
+
+const std::vector<uint64_t>* OcclusionCuller::wait_for_pass(
+    std::chrono::microseconds budget) {
+  std::unique_lock lock(mutex);
+  if (!cv.wait_for(lock, budget, [&] { return !busy; })) {
+    return nullptr;
+  }
+  return &visible;
+}
+
+void OcclusionCuller::worker_loop() {
+  while (true) {
+    {
+      std::unique_lock lock(mutex);
+      cv.wait(lock, [&] { return stopping || pass_queued; });
+      if (stopping) {
+        return;
+      }
+      pass_queued = false;
+    }
+
+    run_pass();
+
+    {
+      std::lock_guard lock(mutex);
+      busy = false;
+    }
+    cv.notify_all();
+  }
+}
+
+void OcclusionCuller::run_pass() {
+  auto before = std::chrono::steady_clock::now();
+
+  // the camera is where clip space (0, 0, 1, 0) comes from
+  inverse_view_projection = glm::inverse(glm::dmat4(view_projection));
+  auto camera = inverse_view_projection * glm::dvec4(0.0, 0.0, 1.0, 0.0);
+  eye = glm::dvec3(camera) / camera.w;
+
+  std::fill(depth.begin(), depth.end(), 0.0f);
+  for (auto& bb : occluders) {
+    rasterize_box(bb);
+  }
+
+  visible.assign((occludees.size() + 63) / 64, 0);
+  for (size_t i = 0; i < occludees.size(); i++) {
+    visible[i / 64] |= (uint64_t)test_box(occludees.get(i)) << (i % 64);
+  }
+
+  auto after = std::chrono::steady_clock::now();
+  pass_time_ms =
+      std::chrono::duration<double, std::milli>(after - before).count();
+}
+
+// a ray through a pixel of the box's silhouette enters it through the
+// farthest of its front face planes, so 1 / w of the box is the min of the
+// planes' 1 / w there. Pixels the silhouette fully covers get that min at the
+// pixel corner farthest on each plane, which bounds the whole pixel
+void OcclusionCuller::rasterize_box(const BoundingBox& bb) {
+  // a point on the ray through ndc (x, y) is inverse * (x, y, 0, 1), with
+  // clip w 1, and the camera is inverse * (0, 0, 1, 0), with clip w 0. Where
+  // the ray meets plane p, 1 / w = q.w - e.w * (p . q) / (p . e), linear in
+  // x and y
+  DepthPlane planes[3];
+  int plane_count = 0;
+  auto& inverse = inverse_view_projection;
+  auto row = [&](int i) {
+    return glm::dvec4(inverse[0][i], inverse[1][i], inverse[2][i],
+                      inverse[3][i]);
+  };
+  for (auto axis = 0; axis < 3; axis++) {
+    for (auto side = 0; side < 2; side++) {
+      // outward normal along the axis, distance from the camera to the face
+      double normal = side == 0 ? -1.0 : 1.0;
+      double offset = side == 0 ? bb.min[axis] : -bb.max[axis];
+      double distance = normal * eye[axis] + offset;
+      if (std::abs(distance) < EDGE_ON_DISTANCE) {
+        return;
+      }
+      if (distance < 0) {
+        continue;
+      }
+      auto r = row(3) - (normal * row(axis) + offset * row(3)) / distance;
+      // from ndc to pixels
+      auto plane = DepthPlane{.a = (float)(r.x * 2.0 / WIDTH),
+                              .b = (float)(r.y * 2.0 / HEIGHT),
+                              .c = (float)(r.w - r.x - r.y)};
+      if (!std::isfinite(plane.a) || !std::isfinite(plane.b) ||
+          !std::isfinite(plane.c)) {
+        return;
+      }
+      planes[plane_count++] = plane;
+    }
+  }
+  // NOTE: the camera is inside the box
+  if (plane_count == 0) {
+    return;
+  }
+
+  // the silhouette of the part of the box past w = NEAR_W
+  glm::vec4 corners[8];
+  for (auto i = 0; i < 8; i++) {
+    corners[i] = view_projection * glm::vec4(get_corner(bb, i), 1.0f);
+  }
+  ScreenVertex points[16];
+  int count = 0;
+  for (auto& corner : corners) {
+    if (corner.w >= NEAR_W) {
+      points[count++] = to_screen(corner);
+    }
+  }
+  for (auto& e : box_edges) {
+    auto& a = corners[e[0]];
+    auto& b = corners[e[1]];
+    if ((a.w >= NEAR_W) != (b.w >= NEAR_W)) {
+      float t = (NEAR_W - a.w) / (b.w - a.w);
+      points[count++] = to_screen(a + (b - a) * t);
+    }
+  }
+  count = convex_hull(points, count);
+  if (count < 3) {
+    return;
+  }
+
+  float min_x = WIDTH, max_x = 0, min_y = HEIGHT, max_y = 0;
+  for (auto i = 0; i < count; i++) {
+    min_x = std::min(min_x, points[i].x);
+    max_x = std::max(max_x, points[i].x);
+    min_y = std::min(min_y, points[i].y);
+    max_y = std::max(max_y, points[i].y);
+  }
+  int x_begin = std::max(0, (int)std::floor(min_x));
+  int x_end = std::min(WIDTH, (int)std::ceil(max_x));
+  int y_begin = std::max(0, (int)std::floor(min_y));
+  int y_end = std::min(HEIGHT, (int)std::ceil(max_y));
+
+  // every edge's function moves the most over a pixel by half a pixel step
+  // along each axis, so a pixel is inside when its centre is that far in
+  float steps[16];
+  float margins[16];
+  for (auto k = 0; k < count; k++) {
+    auto& a = points[k];
+    auto& b = points[(k + 1) % count];
+    steps[k] = -(b.y - a.y);
+    margins[k] = HALF_PIXEL * (std::abs(b.y - a.y) + std::abs(b.x - a.x));
+  }
+  float depth_steps[3];
+  for (auto j = 0; j < plane_count; j++) {
+    depth_steps[j] = planes[j].a;
+  }
+
+  for (auto y = y_begin; y < y_end; y++) {
+    float px = x_begin + 0.5f;
+    float py = y + 0.5f;
+    // pixels i = x - x_begin where e[k] + steps[k] * i >= 0 for every k, the
+    // edge functions change by a constant per pixel along a row
+    float i_begin = 0.0f;
+    float i_end = x_end - x_begin;
+    for (auto k = 0; k < count; k++) {
+      float e =
+          edge(points[k], points[(k + 1) % count], px, py) - margins[k];
+      if (steps[k] > 0) {
+        i_begin = std::max(i_begin, std::ceil(-e / steps[k]));
+      } else if (steps[k] < 0) {
+        i_end = std::min(i_end, std::floor(-e / steps[k]) + 1);
+      } else if (e < 0) {
+        i_end = 0;
+      }
+    }
+    if (i_begin >= i_end) {
+      continue;
+    }
+
+    float depth_starts[3];
+    for (auto j = 0; j < plane_count; j++) {
+      auto& plane = planes[j];
+      depth_starts[j] = plane.a * px + plane.b * py + plane.c -
+                        HALF_PIXEL * (std::abs(plane.a) + std::abs(plane.b));
+    }
+    float* row = &depth[y * WIDTH + x_begin];
+    if (use_avx) {
+      fill_span_avx(row, (int)i_begin, (int)i_end, depth_starts, depth_steps,
+                    plane_count);
+    } else {
+      fill_span(row, (int)i_begin, (int)i_end, depth_starts, depth_steps,
+                plane_count);
+    }
+  }
+}
+
+// visible unless every pixel its screen rectangle touches is fully covered by
+// an occluder, all of it in front of the box's nearest corner
+bool OcclusionCuller::test_box(const BoundingBox& bb) const {
+  float min_x = WIDTH, max_x = 0, min_y = HEIGHT, max_y = 0;
+  float nearest = 0;
+  for (auto i = 0; i < 8; i++) {
+    auto clip = view_projection * glm::vec4(get_corner(bb, i), 1.0f);
+    if (clip.w < NEAR_W) {
+      return true;
+    }
+    auto v = to_screen(clip);
+    min_x = std::min(min_x, v.x);
+    max_x = std::max(max_x, v.x);
+    min_y = std::min(min_y, v.y);
+    max_y = std::max(max_y, v.y);
+    nearest = std::max(nearest, v.depth);
+  }
+
+  // NOTE: grown by the slack HALF_PIXEL has on half a pixel, for rounding
+  float slack = HALF_PIXEL - 0.5f;
+  int x_begin = std::max(0, (int)std::floor(min_x - slack));
+  int x_end = std::min(WIDTH, (int)std::floor(max_x + slack) + 1);
+  int y_begin = std::max(0, (int)std::floor(min_y - slack));
+  int y_end = std::min(HEIGHT, (int)std::floor(max_y + slack) + 1);
+  // off screen, the frustum test is the authority on those
+  if (x_begin >= x_end || y_begin >= y_end) {
+    return true;
+  }
+
+  float occluded_depth = nearest * (1.0f + DEPTH_BIAS);
+  for (auto y = y_begin; y < y_end; y++) {
+    const float* row = &depth[y * WIDTH + x_begin];
+    if (use_avx ? any_at_most_avx(row, x_end - x_begin, occluded_depth)
+                : any_at_most(row, x_end - x_begin, occluded_depth)) {
+      return true;
+    }
+  }
+  return false;
+}
@@ -0,0 +1,74 @@
+#pragma once
+#include "frustum.h" // for BoundingBoxList
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <glm/glm.hpp>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// software occlusion culling on its own worker thread. A pass rasterizes
+// occluder boxes (solid ground under each nearby chunk) into a coarse depth
+// buffer, then tests every occludee box's screen rectangle against it. Both
+// sides are conservative, so a box is only culled when it is hidden. The
+// render thread starts a pass, does other work, and waits for the result for
+// at most a frame budget. A late pass is dropped and the frame is drawn with
+// frustum culling only.
+// NOTE: inputs are copied in, so a pass never reads live chunk data
+class OcclusionCuller {
+public:
+  static constexpr int WIDTH = 256;
+  static constexpr int HEIGHT = 160;
+
+private:
+  glm::mat4 view_projection;
+  std::vector<BoundingBox> occluders;
+  BoundingBoxList occludees;
+  // 1 / clip w of the farthest point of an occluder over a pixel it fully
+  // covers, the nearest such occluder per pixel, 0 where there is none.
+  // 1 / w is linear in screen space over a plane, unlike w
+  std::vector<float> depth;
+  // of view_projection, and the camera position it gives
+  glm::dmat4 inverse_view_projection;
+  glm::dvec3 eye;
+  std::vector<uint64_t> visible;
+  std::atomic<double> pass_time_ms = 0.0;
+  bool use_avx;
+
+  std::mutex mutex;
+  std::condition_variable cv;
+  bool pass_queued = false;
+  // from begin_pass until the worker is done with the pass
+  bool busy = false;
+  bool stopping = false;
+  // NOTE: last, so it starts once everything it uses is constructed
+  std::thread worker;
+
+  void worker_loop();
+  void run_pass();
+  void rasterize_box(const BoundingBox& bb);
+  bool test_box(const BoundingBox& bb) const;
+
+public:
+  OcclusionCuller();
+  ~OcclusionCuller();
+  OcclusionCuller(const OcclusionCuller&) = delete;
+  OcclusionCuller& operator=(const OcclusionCuller&) = delete;
+
+  // false if the previous pass is still running
+  bool begin_pass(const glm::mat4& view_projection,
+                  const std::vector<BoundingBox>& occluders,
+                  const BoundingBoxList& occludees);
+
+  // waits up to budget for the pass started by begin_pass. Returns its
+  // result, a bitmask indexed like the occludees (bit i % 64 of word i / 64
+  // set if visible), or nullptr if the pass didn't finish in time
+  const std::vector<uint64_t>* wait_for_pass(
+      std::chrono::microseconds budget);
+
+  // of the last pass that finished
+  [[nodiscard]] double get_pass_time() const {
+    return pass_time_ms;
+  }
+};
@@ -0,0 +1,143 @@
+#pragma once
+#include "common.h"
+#include <cstdint>
+#include <vector>
+
+// palette compressed storage for a fixed number of values. Every slot holds an
+// index into a small palette of distinct values, bit packed at 0/1/2/4/8 bits
+// per slot depending on the palette size. 0 bits means every slot holds the
+// single palette entry, so an all air chunk costs next to nothing.
+// NOTE: index widths are powers of 2 so an index never straddles two words
+template <typename T>
+class PaletteStorage {
+private:
+  static constexpr int MAX_PALETTE_SIZE = 256;
+
+  int size;
+  int bits_per_index = 0;
+  // log2 of indices per word, so lookups can shift instead of divide
+  int indices_per_word_shift = 0;
+  std::vector<T> palette;
+  std::vector<uint64_t> words;
+
+  [[nodiscard]] int get_index(int slot) const {
+    if (bits_per_index == 0) {
+      return 0;
+    }
+    int word = slot >> indices_per_word_shift;
+    int bit = (slot & ((1 << indices_per_word_shift) - 1)) * bits_per_index;
+    return (words[word] >> bit) & ((1ull << bits_per_index) - 1);
+  }
+
+  void set_index(int slot, int index) {
+    int word = slot >> indices_per_word_shift;
+    int bit = (slot & ((1 << indices_per_word_shift) - 1)) * bits_per_index;
+    uint64_t mask = ((1ull << bits_per_index) - 1) << bit;
+    words[word] = (words[word] & ~mask) | ((uint64_t)index << bit);
+  }
+
+  // switches to a new index width, leaving every index zeroed
+  void set_index_width(int bits) {
+    bits_per_index = bits;
+    indices_per_word_shift = 0;
+    words.clear();
+    if (bits == 0) {
+      return;
+    }
+    while ((64 >> indices_per_word_shift) > bits_per_index) {
+      indices_per_word_shift++;
+    }
+    words.assign((size + (1 << indices_per_word_shift) - 1) >>
+                     indices_per_word_shift,
+                 0);
+  }
+
+  // repacks every index at the next width that can address the palette
+  void grow() {
+    std::vector<int> indices(size);
+    for (auto i = 0; i < size; i++) {
+      indices[i] = get_index(i);
+    }
+
+    set_index_width(bits_per_index == 0 ? 1 : bits_per_index * 2);
+    for (auto i = 0; i < size; i++) {
+      set_index(i, indices[i]);
+    }
+  }
+
+public:
+  PaletteStorage(int size, T fill) : size(size) {
+    palette.push_back(fill);
+  }
+
+  [[nodiscard]] T get(int slot) const {
+    return palette[get_index(slot)];
+  }
+
+  void set(int slot, T value) {
+    int index = 0;
+    while (index < (int)palette.size() && palette[index] != value) {
+      index++;
+    }
+
+    if (index == (int)palette.size()) {
+      if (index == MAX_PALETTE_SIZE) {
+        PANIC("Palette storage ran out of palette entries!\n");
+      }
+      palette.push_back(value);
+      if ((int)palette.size() > (1 << bits_per_index)) {
+        grow();
+      }
+    }
+
+    if (bits_per_index != 0) {
+      set_index(slot, index);
+    }
+  }
+
+  // drops palette entries that no slot refers to anymore and shrinks the index
+  // width to match. A storage filled with a single value ends up with no
+  // index data at all
+  void compact() {
+    if (bits_per_index == 0) {
+      return;
+    }
+
+    std::vector<int> indices(size);
+    std::vector<int> remap(palette.size(), -1);
+    std::vector<T> used_palette;
+    for (auto i = 0; i < size; i++) {
+      int index = get_index(i);
+      if (remap[index] == -1) {
+        remap[index] = used_palette.size();
+        used_palette.push_back(palette[index]);
+      }
+      indices[i] = remap[index];
+    }
+    palette = std::move(used_palette);
+
+    int bits = 0;
+    while ((1 << bits) < (int)palette.size()) {
+      bits = bits == 0 ? 1 : bits * 2;
+    }
+    set_index_width(bits);
+    if (bits != 0) {
+      for (auto i = 0; i < size; i++) {
+        set_index(i, indices[i]);
+      }
+    }
+  }
+
+  // every slot holds the same value (palette[0])
+  [[nodiscard]] bool is_uniform() const {
+    return bits_per_index == 0;
+  }
+
+  [[nodiscard]] int get_bits_per_index() const {
+    return bits_per_index;
+  }
+
+  [[nodiscard]] size_t get_byte_size() const {
+    return palette.size() * sizeof(T) + words.size() * sizeof(uint64_t);
+  }
+};
@@ -1,4 +1,5 @@
 #pragma once
+#include "camera_path.h"
 #include "common.h"
 #include "frustum.h"
 #include "window.h"
@@ -49,6 +50,21 @@ public:
     return camera_pos;
   }
 
+  glm::vec3 get_front() const {
+    return camera_front;
+  }
+
+  CameraPose get_pose() const {
+    return CameraPose{.pos = camera_pos, .yaw = yaw, .pitch = pitch};
+  }
+
+  void set_pose(const CameraPose& pose) {
+    camera_pos = pose.pos;
+    yaw = pose.yaw;
+    pitch = pose.pitch;
+    calculate_camera_vectors();
+  }
+
   void update_frustum() {
     static glm::mat4 test_projection =
         glm::perspective(glm::radians(fovy - 30.0f), aspect_ratio, znear, zfar);
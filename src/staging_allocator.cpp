@@ -0,0 +1,96 @@
+#include "staging_allocator.h"
+#include "common.h"
+#include <algorithm>
+
+StagingAllocator::StagingAllocator(int capacity) : capacity(capacity) {}
+
+std::optional<StagingRange> StagingAllocator::try_allocate_locked(int size) {
+  if (size <= 0 || size > capacity) {
+    PANIC("Invalid staging range size: {} bytes!\n", size);
+  }
+  int offset = head % capacity;
+  uint64_t begin = head;
+  if (offset + size > capacity) {
+    begin += capacity - offset;
+    offset = 0;
+  }
+  if (begin + size - tail > (uint64_t)capacity) {
+    return std::nullopt;
+  }
+  entries.push_back(Entry{
+      .begin = head, .end = begin + size, .release_serial = NOT_RELEASED});
+  head = begin + size;
+  return StagingRange{.offset = offset, .size = size, .position = begin};
+}
+
+bool StagingAllocator::retire_locked() {
+  bool freed = false;
+  while (!entries.empty() &&
+         entries.front().release_serial <= completed_serial) {
+    tail = entries.front().end;
+    entries.pop_front();
+    freed = true;
+  }
+  return freed;
+}
+
+std::optional<StagingRange> StagingAllocator::allocate(int size) {
+  std::unique_lock lock(mutex);
+  std::optional<StagingRange> range;
+  freed_cv.wait(lock, [&] {
+    return closed || (range = try_allocate_locked(size)).has_value();
+  });
+  if (closed) {
+    return std::nullopt;
+  }
+  return range;
+}
+
+std::optional<StagingRange> StagingAllocator::try_allocate(int size) {
+  std::lock_guard lock(mutex);
+  if (closed) {
+    return std::nullopt;
+  }
+  return try_allocate_locked(size);
+}
+
+void StagingAllocator::release(const StagingRange& range, uint64_t serial) {
+  bool freed;
+  {
+    std::lock_guard lock(mutex);
+    // entries are sorted by end, which is unique to every range
+    auto end = range.position + range.size;
+    auto it = std::lower_bound(
+        entries.begin(), entries.end(), end,
+        [](const Entry& entry, uint64_t end) { return entry.end < end; });
+    if (it == entries.end() || it->end != end ||
+        it->release_serial != NOT_RELEASED) {
+      PANIC("Released a staging range that isn't in use!\n");
+    }
+    it->release_serial = serial;
+    freed = retire_locked();
+  }
+  if (freed) {
+    freed_cv.notify_all();
+  }
+}
+
+void StagingAllocator::complete(uint64_t serial) {
+  bool freed;
+  {
+    std::lock_guard lock(mutex);
+    completed_serial = std::max(completed_serial, serial);
+    freed = retire_locked();
+  }
+  if (freed) {
+    freed_cv.notify_all();
+  }
+}
+
+void StagingAllocator::close() {
+  {
+    std::lock_guard lock(mutex);
+    closed = true;
+  }
+  freed_cv.notify_all();
+}
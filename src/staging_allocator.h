@@ -0,0 +1,72 @@
+#pragma once
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <optional>
+
+// a byte range of the staging ring handed out by a StagingAllocator.
+// position counts every byte handed out before it, so the range can still be
+// told apart from later ones at the same offset once the ring has wrapped
+struct StagingRange {
+  int offset;
+  int size;
+  uint64_t position;
+};
+
+// hands out ranges of a ring buffer to any thread, and frees them in the order
+// they were handed out. A released range is only free once the serial it was
+// released with is complete (eg: the gpu has copied out of it), and every range
+// handed out before it is free too. Meshers wait in allocate() for the render
+// thread's copies to free up room
+// NOTE: ranges never wrap, the end of the ring is skipped when a range doesn't
+// fit before it
+class StagingAllocator {
+private:
+  static constexpr uint64_t NOT_RELEASED = UINT64_MAX;
+
+  // an outstanding range, begin includes the end of the ring it skipped
+  struct Entry {
+    uint64_t begin;
+    uint64_t end;
+    uint64_t release_serial;
+  };
+
+  int capacity;
+  std::mutex mutex;
+  std::condition_variable freed_cv;
+  // oldest first
+  std::deque<Entry> entries;
+  uint64_t head = 0;
+  uint64_t tail = 0;
+  uint64_t completed_serial = 0;
+  bool closed = false;
+
+  std::optional<StagingRange> try_allocate_locked(int size);
+  // frees the released ranges at the front, returns whether any were
+  bool retire_locked();
+
+public:
+  explicit StagingAllocator(int capacity);
+
+  // waits until size bytes fit, returns std::nullopt once closed. size must
+  // be positive and no larger than the capacity
+  std::optional<StagingRange> allocate(int size);
+  // never waits
+  std::optional<StagingRange> try_allocate(int size);
+  // the range is freed once serial is complete, 0 frees it straight away
+  void release(const StagingRange& range, uint64_t serial);
+  // every serial up to this one is complete
+  void complete(uint64_t serial);
+  // wakes up every allocate(), they return std::nullopt from now on
+  void close();
+
+  [[nodiscard]] int get_bytes_in_use() {
+    std::lock_guard lock(mutex);
+    return head - tail;
+  }
+
+  [[nodiscard]] int get_capacity() const {
+    return capacity;
+  }
+};
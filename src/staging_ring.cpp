@@ -0,0 +1,47 @@
+#include "staging_ring.h"
+#include "common.h"
+
+StagingRing::StagingRing(int capacity) : allocator(capacity) {
+  GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT |
+                     GL_MAP_COHERENT_BIT;
+  glCreateBuffers(1, &buffer);
+  glNamedBufferStorage(buffer, capacity, nullptr, flags);
+  mapped = (char*)glMapNamedBufferRange(buffer, 0, capacity, flags);
+  if (!mapped) {
+    PANIC("Failed to map the staging buffer!\n");
+  }
+}
+
+StagingRing::~StagingRing() {
+  for (auto& [serial, fence] : fences) {
+    glDeleteSync(fence);
+  }
+  glUnmapNamedBuffer(buffer);
+  glDeleteBuffers(1, &buffer);
+}
+
+void StagingRing::begin_frame() {
+  while (!fences.empty()) {
+    auto [serial, fence] = fences.front();
+    GLenum result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+    if (result == GL_TIMEOUT_EXPIRED) {
+      break;
+    }
+    if (result == GL_WAIT_FAILED) {
+      PANIC("Failed to wait on a staging buffer fence!\n");
+    }
+    allocator.complete(serial);
+    glDeleteSync(fence);
+    fences.pop_front();
+  }
+}
+
+void StagingRing::end_frame() {
+  // nothing to wait on if nothing was copied
+  if (!frame_released) {
+    return;
+  }
+  fences.emplace_back(frame_serial++,
+                      glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0));
+  frame_released = false;
+}
@@ -0,0 +1,68 @@
+#pragma once
+#include "staging_allocator.h"
+#include <deque>
+#include <glad/glad.h>
+#include <optional>
+#include <utility>
+
+// persistently mapped upload buffer. Meshers write finished meshes straight
+// into ranges of it, and the render thread copies them from there into their
+// destination buffer on the gpu, so uploads never wait on the driver to orphan
+// or sync the destination. The ranges a frame's copies read from are only
+// handed out again once the fence placed after those copies has signalled
+class StagingRing {
+private:
+  GLuint buffer;
+  char* mapped;
+  StagingAllocator allocator;
+  // placed after each frame that released ranges, oldest first. The serial is
+  // what the ranges were released with
+  std::deque<std::pair<uint64_t, GLsync>> fences;
+  uint64_t frame_serial = 1;
+  bool frame_released = false;
+
+public:
+  explicit StagingRing(int capacity);
+  ~StagingRing();
+  StagingRing(const StagingRing&) = delete;
+  StagingRing& operator=(const StagingRing&) = delete;
+
+  // frees the ranges the gpu is done copying out of, never waits
+  void begin_frame();
+  // fences the copies issued this frame
+  void end_frame();
+
+  // called by any thread, waits for room (see StagingAllocator::allocate)
+  std::optional<StagingRange> allocate(int size) {
+    return allocator.allocate(size);
+  }
+
+  char* get_pointer(const StagingRange& range) const {
+    return mapped + range.offset;
+  }
+
+  // called by the render thread once the copies out of range are issued
+  void release(const StagingRange& range) {
+    allocator.release(range, frame_serial);
+    frame_released = true;
+  }
+
+  // called by any thread for a range nothing was copied out of
+  void drop(const StagingRange& range) {
+    allocator.release(range, 0);
+  }
+
+  // fails every allocate() from now on, so no mesher waits on a render thread
+  // that stopped uploading
+  void close() {
+    allocator.close();
+  }
+
+  [[nodiscard]] GLuint get_buffer() const {
+    return buffer;
+  }
+
+  [[nodiscard]] int get_capacity() const {
+    return allocator.get_capacity();
+  }
+};
@@ -0,0 +1,224 @@
+#include "terrain_generator.h"
+#include <algorithm>
+#include <cmath>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define TERRAIN_GENERATOR_AVX2
+#include <immintrin.h>
+#endif
+
+TerrainGenerator::TerrainGenerator(uint32_t seed,
+                                   CurveInterpolation interpolation)
+    : seed(seed), perlin_noise(seed),
+      height_curve({HEIGHT_CURVE_POINTS.begin(), HEIGHT_CURVE_POINTS.end()},
+                   interpolation) {
+  auto& state = perlin_noise.serialize();
+  std::copy(state.begin(), state.end(), permutation.begin());
+
+#ifdef TERRAIN_GENERATOR_AVX2
+  use_avx2 = __builtin_cpu_supports("avx2");
+#else
+  use_avx2 = false;
+#endif
+}
+
+Heightmap TerrainGenerator::create_heightmap(ChunkPos chunk_pos) const {
+  std::array<double, CHUNK_WIDTH * CHUNK_DEPTH> noise;
+  sample_noise(chunk_pos, noise);
+
+  Heightmap heights;
+  for (auto i = 0; i < CHUNK_WIDTH * CHUNK_DEPTH; i++) {
+    heights[i] = height_curve.evaluate(noise[i]);
+  }
+  return heights;
+}
+
+double TerrainGenerator::get_column_random(ChunkPos chunk_pos, int x,
+                                           int z) const {
+  uint64_t h = mix_bits(seed);
+  h = mix_bits(h ^ pack_chunk_pos(chunk_pos));
+  h = mix_bits(h ^ (x + z * CHUNK_WIDTH));
+  // top 53 bits as a double in [0, 1)
+  return (h >> 11) * 0x1.0p-53;
+}
+
+void TerrainGenerator::sample_noise(
+    ChunkPos chunk_pos,
+    std::array<double, CHUNK_WIDTH * CHUNK_DEPTH>& out) const {
+  int x_offset = chunk_pos.x * CHUNK_WIDTH;
+  int z_offset = chunk_pos.z * CHUNK_DEPTH;
+
+  // NOTE: coords are scaled in float precision like they always have been,
+  // changing that would shift every world
+  alignas(32) std::array<double, CHUNK_WIDTH> xs;
+  for (auto x = 0; x < CHUNK_WIDTH; x++) {
+    xs[x] = (x_offset + x) * PERLIN_SCALE;
+  }
+
+  for (auto z = 0; z < CHUNK_DEPTH; z++) {
+    double y = (z_offset - z) * PERLIN_SCALE;
+    double* row = &out[z * CHUNK_WIDTH];
+    if (use_avx2) {
+      sample_noise_avx2(xs.data(), y, row);
+    } else {
+      sample_noise_scalar(xs.data(), y, row);
+    }
+  }
+}
+
+void TerrainGenerator::sample_noise_scalar(const double* xs, double y,
+                                           double* out) const {
+  for (auto x = 0; x < CHUNK_WIDTH; x++) {
+    out[x] = perlin_noise.octave2D_11(xs[x], y, PERLIN_OCTAVES,
+                                      PERLIN_PERSISTENCE);
+  }
+}
+
+#ifdef TERRAIN_GENERATOR_AVX2
+
+// NOTE: the helpers below mirror siv::perlin_detail, keeping the order of every
+// operation so the results match bit for bit (no fma contraction either)
+template <class Float>
+static Float fade(Float t) {
+  return t * t * t * (t * (t * 6 - 15) + 10);
+}
+
+__attribute__((target("avx2"))) static __m256d fade4(__m256d t) {
+  __m256d t3 = _mm256_mul_pd(_mm256_mul_pd(t, t), t);
+  __m256d inner = _mm256_sub_pd(_mm256_mul_pd(t, _mm256_set1_pd(6)),
+                                _mm256_set1_pd(15));
+  inner = _mm256_add_pd(_mm256_mul_pd(t, inner), _mm256_set1_pd(10));
+  return _mm256_mul_pd(t3, inner);
+}
+
+__attribute__((target("avx2"))) static __m256d lerp4(__m256d a, __m256d b,
+                                                     __m256d t) {
+  return _mm256_add_pd(a, _mm256_mul_pd(_mm256_sub_pd(b, a), t));
+}
+
+// NOTE: lambdas don't inherit the target attribute, hence the small helpers
+__attribute__((target("avx2"))) static __m256d as_mask(__m256i mask) {
+  return _mm256_castsi256_pd(mask);
+}
+
+__attribute__((target("avx2"))) static __m256d grad4(__m128i hash, __m256d x,
+                                                     __m256d y, __m256d z) {
+  __m256i h = _mm256_cvtepi32_epi64(_mm_and_si128(hash, _mm_set1_epi32(15)));
+  __m256d below_8 = as_mask(_mm256_cmpgt_epi64(_mm256_set1_epi64x(8), h));
+  __m256d below_4 = as_mask(_mm256_cmpgt_epi64(_mm256_set1_epi64x(4), h));
+  __m256d is_12_or_14 =
+      as_mask(_mm256_or_si256(_mm256_cmpeq_epi64(h, _mm256_set1_epi64x(12)),
+                              _mm256_cmpeq_epi64(h, _mm256_set1_epi64x(14))));
+  __m256i bit_1 = _mm256_set1_epi64x(1);
+  __m256i bit_2 = _mm256_set1_epi64x(2);
+  __m256d negate_u =
+      as_mask(_mm256_cmpeq_epi64(_mm256_and_si256(h, bit_1), bit_1));
+  __m256d negate_v =
+      as_mask(_mm256_cmpeq_epi64(_mm256_and_si256(h, bit_2), bit_2));
+
+  // u = h < 8 ? x : y
+  // v = h < 4 ? y : h == 12 || h == 14 ? x : z
+  __m256d u = _mm256_blendv_pd(y, x, below_8);
+  __m256d v = _mm256_blendv_pd(z, x, is_12_or_14);
+  v = _mm256_blendv_pd(v, y, below_4);
+
+  // negations only flip the sign bit
+  __m256d sign = _mm256_set1_pd(-0.0);
+  u = _mm256_xor_pd(u, _mm256_and_pd(negate_u, sign));
+  v = _mm256_xor_pd(v, _mm256_and_pd(negate_v, sign));
+  return _mm256_add_pd(u, v);
+}
+
+__attribute__((target("avx2"))) static __m128i perm4(const int32_t* permutation,
+                                                     __m128i index) {
+  return _mm_i32gather_epi32(permutation, index, 4);
+}
+
+// (i + offset) & 255
+__attribute__((target("avx2"))) static __m128i wrap4(__m128i i,
+                                                     __m128i offset) {
+  return _mm_and_si128(_mm_add_epi32(i, offset), _mm_set1_epi32(255));
+}
+
+// siv::PerlinNoise::noise3D for 4 x coords sharing y and z
+__attribute__((target("avx2"))) static __m256d
+noise4(const int32_t* permutation, __m256d x, double y, double z) {
+  __m256d floor_x = _mm256_floor_pd(x);
+  double floor_y = std::floor(y);
+  double floor_z = std::floor(z);
+  __m128i ix =
+      _mm_and_si128(_mm256_cvttpd_epi32(floor_x), _mm_set1_epi32(255));
+  __m128i iy = _mm_set1_epi32((int32_t)floor_y & 255);
+  __m128i iz = _mm_set1_epi32((int32_t)floor_z & 255);
+  __m128i one = _mm_set1_epi32(1);
+
+  __m256d fx = _mm256_sub_pd(x, floor_x);
+  double fy = y - floor_y;
+  double fz = z - floor_z;
+  __m256d u = fade4(fx);
+  __m256d v = _mm256_set1_pd(fade(fy));
+  __m256d w = _mm256_set1_pd(fade(fz));
+
+  __m128i a = wrap4(perm4(permutation, ix), iy);
+  __m128i b = wrap4(perm4(permutation, wrap4(ix, one)), iy);
+  __m128i aa = wrap4(perm4(permutation, a), iz);
+  __m128i ab = wrap4(perm4(permutation, wrap4(a, one)), iz);
+  __m128i ba = wrap4(perm4(permutation, b), iz);
+  __m128i bb = wrap4(perm4(permutation, wrap4(b, one)), iz);
+
+  __m256d fx1 = _mm256_sub_pd(fx, _mm256_set1_pd(1));
+  __m256d fy0 = _mm256_set1_pd(fy);
+  __m256d fy1 = _mm256_set1_pd(fy - 1);
+  __m256d fz0 = _mm256_set1_pd(fz);
+  __m256d fz1 = _mm256_set1_pd(fz - 1);
+
+  __m256d p0 = grad4(perm4(permutation, aa), fx, fy0, fz0);
+  __m256d p1 = grad4(perm4(permutation, ba), fx1, fy0, fz0);
+  __m256d p2 = grad4(perm4(permutation, ab), fx, fy1, fz0);
+  __m256d p3 = grad4(perm4(permutation, bb), fx1, fy1, fz0);
+  __m256d p4 = grad4(perm4(permutation, wrap4(aa, one)), fx, fy0, fz1);
+  __m256d p5 = grad4(perm4(permutation, wrap4(ba, one)), fx1, fy0, fz1);
+  __m256d p6 = grad4(perm4(permutation, wrap4(ab, one)), fx, fy1, fz1);
+  __m256d p7 = grad4(perm4(permutation, wrap4(bb, one)), fx1, fy1, fz1);
+
+  __m256d q0 = lerp4(p0, p1, u);
+  __m256d q1 = lerp4(p2, p3, u);
+  __m256d q2 = lerp4(p4, p5, u);
+  __m256d q3 = lerp4(p6, p7, u);
+  __m256d r0 = lerp4(q0, q1, v);
+  __m256d r1 = lerp4(q2, q3, v);
+  return lerp4(r0, r1, w);
+}
+
+// siv::PerlinNoise::octave2D_11, 4 columns at a time
+__attribute__((target("avx2"))) void
+TerrainGenerator::sample_noise_avx2(const double* xs, double y,
+                                    double* out) const {
+  for (auto i = 0; i < CHUNK_WIDTH; i += 4) {
+    __m256d x = _mm256_loadu_pd(xs + i);
+    double octave_y = y;
+    __m256d result = _mm256_setzero_pd();
+    double amplitude = 1;
+    for (auto octave = 0; octave < PERLIN_OCTAVES; octave++) {
+      __m256d noise =
+          noise4(permutation.data(), x, octave_y, PERLIN_NOISE_2D_Z);
+      result = _mm256_add_pd(
+          result, _mm256_mul_pd(noise, _mm256_set1_pd(amplitude)));
+      x = _mm256_mul_pd(x, _mm256_set1_pd(2));
+      octave_y *= 2;
+      amplitude *= PERLIN_PERSISTENCE;
+    }
+    result = _mm256_max_pd(result, _mm256_set1_pd(-1));
+    result = _mm256_min_pd(result, _mm256_set1_pd(1));
+    _mm256_storeu_pd(out + i, result);
+  }
+}
+
+#else
+
+void TerrainGenerator::sample_noise_avx2(const double* xs, double y,
+                                         double* out) const {
+  sample_noise_scalar(xs, y, out);
+}
+
+#endif
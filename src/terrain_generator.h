@@ -0,0 +1,77 @@
+#pragma once
+#include "PerlinNoise.hpp"
+#include "chunk.h"
+#include "height_curve.h"
+#include <array>
+#include <cstdint>
+
+// terrain height of every column of a chunk, indexed by x + z * CHUNK_WIDTH
+// (local coords)
+using Heightmap = std::array<int, CHUNK_WIDTH * CHUNK_DEPTH>;
+
+// samples the terrain noise for a whole chunk footprint at once. On cpus with
+// avx2, 4 columns are evaluated per call of the noise kernel, which repeats
+// siv::PerlinNoise's arithmetic operation for operation so the heights come
+// out identical to the scalar path (and to worlds generated before this).
+// NOTE: shared by every generation worker, so everything past construction is
+// const
+class TerrainGenerator {
+public:
+  // what every column is sampled with: octave2D_11 at the world position
+  // times PERLIN_SCALE (in float precision)
+  static constexpr float PERLIN_SCALE = 0.035f;
+  static constexpr int PERLIN_OCTAVES = 3;
+  static constexpr double PERLIN_PERSISTENCE = 0.5;
+  // noise value to terrain height
+  static constexpr std::array<CurvePoint, 5> HEIGHT_CURVE_POINTS = {{
+      {.x = -1.0f, .y = 60},
+      {.x = 0.0f, .y = 90},
+      {.x = 0.2f, .y = 95},
+      {.x = 0.4f, .y = 90},
+      {.x = 1.0f, .y = 120},
+  }};
+
+private:
+  // siv::PerlinNoise samples 2d noise on this z plane of its 3d noise
+  static constexpr double PERLIN_NOISE_2D_Z = 0.34567;
+
+  uint32_t seed;
+  siv::PerlinNoise perlin_noise;
+  // siv's permutation widened to 32 bits so it can be gathered from
+  alignas(32) std::array<int32_t, 256> permutation;
+  HeightCurve height_curve;
+  bool use_avx2;
+
+  void sample_noise_scalar(const double* xs, double y, double* out) const;
+  void sample_noise_avx2(const double* xs, double y, double* out) const;
+
+public:
+  // the interpolation shapes the height curve, LINEAR keeps the terrain
+  // worlds have always had
+  explicit TerrainGenerator(
+      uint32_t seed,
+      CurveInterpolation interpolation = CurveInterpolation::LINEAR);
+  TerrainGenerator(const TerrainGenerator&) = delete;
+  TerrainGenerator& operator=(const TerrainGenerator&) = delete;
+
+  [[nodiscard]] Heightmap create_heightmap(ChunkPos chunk_pos) const;
+
+  // raw octave2D_11 noise of every column of a chunk, same indexing as
+  // Heightmap
+  void sample_noise(ChunkPos chunk_pos,
+                    std::array<double, CHUNK_WIDTH * CHUNK_DEPTH>& out) const;
+
+  // uniform in [0, 1). Counter based rather than a stateful engine: the same
+  // seed, chunk and column always give the same value, so regenerating a
+  // chunk gives back the same structures
+  [[nodiscard]] double get_column_random(ChunkPos chunk_pos, int x,
+                                         int z) const;
+
+  [[nodiscard]] uint32_t get_seed() const {
+    return seed;
+  }
+
+  [[nodiscard]] bool is_using_avx2() const {
+    return use_avx2;
+  }
+};
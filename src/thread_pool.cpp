@@ -0,0 +1,86 @@
+#include "thread_pool.h"
+
+ThreadPool::ThreadPool(int thread_count) {
+  for (auto i = 0; i < thread_count; i++) {
+    workers.push_back(std::make_unique<Worker>());
+  }
+  for (auto i = 0; i < thread_count; i++) {
+    threads.emplace_back(&ThreadPool::worker_loop, this, i);
+  }
+}
+
+// NOTE: jobs that haven't started yet are dropped, the ones running finish
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard lock(sleep_mutex);
+    stopping = true;
+  }
+  for (auto& worker : workers) {
+    std::lock_guard lock(worker->mutex);
+    queued_jobs -= worker->jobs.size();
+    worker->jobs.clear();
+  }
+  sleep_cv.notify_all();
+  for (auto& thread : threads) {
+    thread.join();
+  }
+}
+
+// jobs submitted from outside the pool are spread round robin, idle workers
+// even the load out by stealing
+void ThreadPool::submit(std::function<void()> job) {
+  auto& worker = *workers[next_worker++ % workers.size()];
+  {
+    std::lock_guard lock(worker.mutex);
+    worker.jobs.push_back(std::move(job));
+  }
+  {
+    std::lock_guard lock(sleep_mutex);
+    queued_jobs++;
+  }
+  sleep_cv.notify_one();
+}
+
+bool ThreadPool::try_pop(int index, std::function<void()>& job) {
+  // own jobs first, oldest first
+  {
+    auto& worker = *workers[index];
+    std::lock_guard lock(worker.mutex);
+    if (!worker.jobs.empty()) {
+      job = std::move(worker.jobs.front());
+      worker.jobs.pop_front();
+      queued_jobs--;
+      return true;
+    }
+  }
+
+  // then steal the newest job of the other workers
+  for (auto i = 1; i < (int)workers.size(); i++) {
+    auto& victim = *workers[(index + i) % workers.size()];
+    std::lock_guard lock(victim.mutex);
+    if (!victim.jobs.empty()) {
+      job = std::move(victim.jobs.back());
+      victim.jobs.pop_back();
+      queued_jobs--;
+      return true;
+    }
+  }
+  return false;
+}
+
+void ThreadPool::worker_loop(int index) {
+  std::function<void()> job;
+  while (true) {
+    if (try_pop(index, job)) {
+      job();
+      job = nullptr;
+      continue;
+    }
+
+    std::unique_lock lock(sleep_mutex);
+    sleep_cv.wait(lock, [&] { return stopping || queued_jobs > 0; });
+    if (stopping) {
+      return;
+    }
+  }
+}
@@ -0,0 +1,57 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// work stealing thread pool. Each worker owns a deque of jobs: it takes jobs
+// from the front of its own deque and steals from the back of the others once
+// it runs dry. Idle workers sleep on a condition variable instead of spinning
+class ThreadPool {
+private:
+  struct Worker {
+    std::mutex mutex;
+    std::deque<std::function<void()>> jobs;
+  };
+
+  std::vector<std::unique_ptr<Worker>> workers;
+  std::vector<std::thread> threads;
+  std::atomic<unsigned> next_worker = 0;
+
+  // number of jobs sitting in any deque, only incremented under sleep_mutex so
+  // a worker can't miss a wakeup between checking it and going to sleep
+  std::atomic<int> queued_jobs = 0;
+  std::mutex sleep_mutex;
+  std::condition_variable sleep_cv;
+  bool stopping = false;
+
+  void worker_loop(int index);
+  bool try_pop(int index, std::function<void()>& job);
+
+public:
+  // defaults to one worker per hardware thread, minus the render thread
+  explicit ThreadPool(int thread_count = default_thread_count());
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  void submit(std::function<void()> job);
+
+  [[nodiscard]] int get_thread_count() const {
+    return threads.size();
+  }
+
+  [[nodiscard]] int get_queued_jobs() const {
+    return queued_jobs.load(std::memory_order_relaxed);
+  }
+
+  static int default_thread_count() {
+    return std::max(1, (int)std::thread::hardware_concurrency() - 1);
+  }
+};
@@ -0,0 +1,47 @@
+#include "view_distance_scaler.h"
+#include <algorithm>
+
+int ViewDistanceScaler::update(double time, const FrameStats& stats,
+                               int view_distance, int min_view_distance,
+                               int max_view_distance) {
+  frame_ms += (stats.frame_ms - frame_ms) * SMOOTHING;
+  busy_ms += (stats.busy_ms - busy_ms) * SMOOTHING;
+
+  // the limits were changed
+  int clamped =
+      std::clamp(view_distance, min_view_distance, max_view_distance);
+  if (clamped != view_distance) {
+    last_change_time = time;
+    headroom_since = -1.0;
+    return clamped;
+  }
+
+  if (frame_ms > target_frame_ms * OVER_TARGET || stats.over_memory_budget) {
+    headroom_since = -1.0;
+    if (view_distance > min_view_distance &&
+        time - last_change_time >= DOWN_COOLDOWN) {
+      last_change_time = time;
+      return view_distance - 1;
+    }
+    return view_distance;
+  }
+
+  // NOTE: with vsync on frames never take less than the target, so headroom
+  // is judged by the time spent before the swap
+  bool headroom = busy_ms < target_frame_ms * UNDER_TARGET &&
+                  stats.memory_headroom && !stats.loading;
+  if (!headroom) {
+    headroom_since = -1.0;
+    return view_distance;
+  }
+  if (headroom_since < 0.0) {
+    headroom_since = time;
+  }
+  if (view_distance < max_view_distance && time - headroom_since >= UP_DELAY &&
+      time - last_change_time >= UP_DELAY) {
+    last_change_time = time;
+    headroom_since = time;
+    return view_distance + 1;
+  }
+  return view_distance;
+}
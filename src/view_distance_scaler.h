@@ -0,0 +1,55 @@
+#pragma once
+
+// picks the view distance from how long frames take and whether chunk memory
+// is over budget. It steps down a chunk as soon as either goes over (then
+// waits DOWN_COOLDOWN before doing it again), and steps up a chunk once there
+// has been headroom for UP_DELAY. Growing much slower than shrinking keeps it
+// from oscillating around the limit
+class ViewDistanceScaler {
+public:
+  struct FrameStats {
+    // frame to frame, includes waiting on vsync and the gpu
+    double frame_ms;
+    // spent on the render thread before the buffer swap
+    double busy_ms;
+    bool over_memory_budget;
+    bool memory_headroom;
+    // growing while chunks in range still load would only pile more on
+    bool loading;
+  };
+
+private:
+  // exponential smoothing of the frame times, per frame
+  static constexpr double SMOOTHING = 0.1;
+  // smoothed frame time over target by this factor steps down
+  static constexpr double OVER_TARGET = 1.25;
+  // busy time under target by this factor counts as headroom
+  static constexpr double UNDER_TARGET = 0.6;
+  // in seconds
+  static constexpr double DOWN_COOLDOWN = 1.0;
+  static constexpr double UP_DELAY = 3.0;
+
+  double target_frame_ms;
+  double frame_ms = 0.0;
+  double busy_ms = 0.0;
+  double last_change_time = 0.0;
+  // negative while there is no headroom
+  double headroom_since = -1.0;
+
+public:
+  explicit ViewDistanceScaler(double target_frame_ms)
+      : target_frame_ms(target_frame_ms) {
+  }
+
+  // time in seconds, returns the view distance to use from now on
+  int update(double time, const FrameStats& stats, int view_distance,
+             int min_view_distance, int max_view_distance);
+
+  [[nodiscard]] double get_frame_ms() const {
+    return frame_ms;
+  }
+
+  [[nodiscard]] double get_busy_ms() const {
+    return busy_ms;
+  }
+};
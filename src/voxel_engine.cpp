@@ -1,10 +1,32 @@
 #include "voxel_engine.h"
 
-VoxelEngine::VoxelEngine(int viewport_width, int viewport_height)
+VoxelEngine::VoxelEngine(int viewport_width, int viewport_height,
+                         const EngineOptions& options)
     : window(viewport_width, viewport_height, "TEMPLATE"),
       player_camera(45.0f, window.get_viewport_aspect_ratio(), 0.1f, 1000.0f),
-      chunk_manager(player_camera) {
+      chunk_manager(player_camera, options.seed, options.config),
+      camera_replay(options.replay), replay_realtime(options.replay_realtime) {
   glfwSetInputMode(window.get_window(), GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+  if (options.record_path) {
+    camera_recorder.emplace(*options.record_path, chunk_manager.get_seed());
+  }
+  if (camera_replay) {
+    if (camera_replay->poses.empty()) {
+      PANIC("Camera path has no poses!\n");
+    }
+  }
+  // a replay is measured at the configured view distance
+  if (camera_replay) {
+    chunk_manager.set_auto_view_distance(false);
+  }
+  // measures every pose with both cullers and the occlusion pass's result
+  if (camera_replay && !replay_realtime) {
+    chunk_manager.set_cave_culling(true);
+    chunk_manager.set_occlusion_culling(true);
+    chunk_manager.set_occlusion_budget(std::chrono::seconds(1));
+  }
+  chunk_manager.set_prefetch(options.prefetch);
+  chunk_manager.set_row_order(options.row_order);
 }
 
 void VoxelEngine::run() {
@@ -18,9 +40,79 @@ void VoxelEngine::run() {
     ImGui::Begin("FPS", &p_open, window_flags);
     std::string a = fmt::format("Frame time : {:.02f}ms\n", delta_time * 1000.);
     std::string b = fmt::format("FPS        : {:.02f}  \n", 1. / delta_time);
+    std::string c = fmt::format(
+        "Meshing    : {} (G)\n",
+        get_meshing_mode_name(chunk_manager.get_meshing_mode()));
+    std::string d = fmt::format(
+        "Mesh memory: {:.02f}MB / {:.02f}MB\n",
+        chunk_manager.get_gpu_bytes_in_use() / (1024. * 1024.),
+        chunk_manager.get_gpu_bytes_allocated() / (1024. * 1024.));
+    auto voxel_stats = chunk_manager.get_voxel_memory_stats();
+    std::string e = fmt::format(
+        "Voxel memory: {:.02f}MB (flat estimate: {:.02f}MB)\n",
+        voxel_stats.palette_bytes / (1024. * 1024.),
+        voxel_stats.estimated_flat_bytes / (1024. * 1024.));
+    std::string f = fmt::format("Mesh time  : {:.03f}ms/chunk\n",
+                                chunk_manager.get_average_mesh_time());
+    std::string g =
+        fmt::format("Chunks     : {} ({:.02f}MB)\n",
+                    chunk_manager.get_resident_chunk_count(),
+                    chunk_manager.get_resident_bytes() / (1024. * 1024.));
+    std::string h = fmt::format("Uploads    : {} pending\n",
+                                chunk_manager.get_pending_upload_count());
+    std::string i = fmt::format(
+        "Sections   : {} / {} drawn ({} caved, {} occluded)\n",
+        chunk_manager.get_drawn_section_count(),
+        chunk_manager.get_meshed_section_count(),
+        chunk_manager.get_frustum_section_count() -
+            chunk_manager.get_connected_section_count(),
+        chunk_manager.get_connected_section_count() -
+            chunk_manager.get_drawn_section_count());
+    std::string j = fmt::format(
+        "Culling    : cave {} (C) occlusion {} (O) {:.02f}ms\n",
+        chunk_manager.is_cave_culling() ? "on" : "off",
+        chunk_manager.is_occlusion_culling() ? "on" : "off",
+        chunk_manager.get_occlusion_pass_time());
+    auto latency = chunk_manager.get_load_latency_stats();
+    std::string k =
+        fmt::format("Load latency: {:.0f}ms avg, {:.0f}ms worst\n",
+                    latency.average_ms, latency.worst_ms);
+    std::string l = fmt::format(
+        "Prefetch   : {} (L) {} chunks, {} missing in view\n",
+        chunk_manager.is_prefetch() ? "on" : "off",
+        chunk_manager.get_prefetched_chunk_count(),
+        chunk_manager.get_missing_chunk_count());
+    auto& scaler = chunk_manager.get_view_distance_scaler();
+    std::string m = fmt::format(
+        "View       : {} (load {}, unload {}) {:.02f}ms busy\n",
+        chunk_manager.get_view_distance(), chunk_manager.get_load_distance(),
+        chunk_manager.get_unload_distance(), scaler.get_busy_ms());
     ImGui::Text(a.c_str());
     ImGui::Text(b.c_str());
     ImGui::Separator();
+    ImGui::Text(c.c_str());
+    ImGui::Text(d.c_str());
+    ImGui::Text(e.c_str());
+    ImGui::Text(f.c_str());
+    ImGui::Text(g.c_str());
+    ImGui::Text(h.c_str());
+    ImGui::Text(i.c_str());
+    ImGui::Text(j.c_str());
+    ImGui::Text(k.c_str());
+    ImGui::Text(l.c_str());
+    ImGui::Text(m.c_str());
+    ImGui::Separator();
+    // NOTE: only usable once tab releases the mouse
+    int max_view_distance = chunk_manager.get_max_view_distance();
+    if (ImGui::SliderInt("View distance", &max_view_distance,
+                         chunk_manager.get_min_view_distance(),
+                         MAX_VIEW_DISTANCE)) {
+      chunk_manager.set_max_view_distance(max_view_distance);
+    }
+    bool auto_view_distance = chunk_manager.is_auto_view_distance();
+    if (ImGui::Checkbox("Auto scale (Tab)", &auto_view_distance)) {
+      chunk_manager.set_auto_view_distance(auto_view_distance);
+    }
     ImGui::End();
   };
 
@@ -28,6 +120,9 @@ void VoxelEngine::run() {
   while (!glfwWindowShouldClose(window.get_window())) {
     window.imgui_new_frame();
     handle_input();
+    if (camera_replay && replay_pose < camera_replay->poses.size()) {
+      player_camera.set_pose(get_replay_pose());
+    }
     draw_imgui();
 
     glEnable(GL_DEPTH_TEST);
@@ -36,6 +131,9 @@ void VoxelEngine::run() {
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
     chunk_manager.render_chunks();
+    update_camera_path();
+    chunk_manager.update_view_distance(
+        delta_time * 1000, (glfwGetTime() - current_frame) * 1000);
 
     // order is T * R * S to get SRT transformation for model matrix
     // order is P * V * M to get MVP transformation to clip space, then
@@ -61,6 +159,26 @@ void VoxelEngine::handle_input() {
   if (window.key_pressed(GLFW_KEY_P)) {
     toggle_wireframe();
   }
+  if (window.key_just_pressed(GLFW_KEY_TAB)) {
+    mouse_captured = !mouse_captured;
+    glfwSetInputMode(
+        window.get_window(), GLFW_CURSOR,
+        mouse_captured ? GLFW_CURSOR_DISABLED : GLFW_CURSOR_NORMAL);
+  }
+  if (window.key_just_pressed(GLFW_KEY_C)) {
+    chunk_manager.set_cave_culling(!chunk_manager.is_cave_culling());
+  }
+  if (window.key_just_pressed(GLFW_KEY_L)) {
+    chunk_manager.set_prefetch(!chunk_manager.is_prefetch());
+  }
+  if (window.key_just_pressed(GLFW_KEY_O)) {
+    chunk_manager.set_occlusion_culling(!chunk_manager.is_occlusion_culling());
+  }
+  if (window.key_just_pressed(GLFW_KEY_G)) {
+    // cycles naive -> greedy -> binary
+    auto next = ((int)chunk_manager.get_meshing_mode() + 1) % 3;
+    chunk_manager.set_meshing_mode((MeshingMode)next);
+  }
   if (window.key_pressed(GLFW_KEY_W)) {
     player_camera.process_input(Direction::FORWARD, delta_time);
   }
@@ -80,8 +198,117 @@ void VoxelEngine::handle_input() {
   static double new_mouse_y = 0;
 
   glfwGetCursorPos(window.get_window(), &new_mouse_x, &new_mouse_y);
-  player_camera.process_mouse_input(new_mouse_x - mouse_x,
-                                    mouse_y - new_mouse_y);
+  if (mouse_captured) {
+    player_camera.process_mouse_input(new_mouse_x - mouse_x,
+                                      mouse_y - new_mouse_y);
+  }
   mouse_x = new_mouse_x;
   mouse_y = new_mouse_y;
 }
+
+void VoxelEngine::update_camera_path() {
+  if (camera_recorder) {
+    camera_recorder->record(current_frame, player_camera.get_pose());
+  }
+  if (replay_realtime) {
+    update_realtime_replay();
+    return;
+  }
+
+  // a pose is held until everything in view is loaded, so its numbers don't
+  // depend on how fast chunks streamed in
+  if (!camera_replay || replay_pose == camera_replay->poses.size() ||
+      chunk_manager.is_loading() || !chunk_manager.is_occlusion_applied()) {
+    return;
+  }
+  replay_stats.push_back(ReplayStats{
+      .frustum_sections = chunk_manager.get_frustum_section_count(),
+      .connected_sections = chunk_manager.get_connected_section_count(),
+      .drawn_sections = chunk_manager.get_drawn_section_count(),
+      .pass_time = chunk_manager.get_occlusion_pass_time()});
+  replay_pose++;
+  if (replay_pose == camera_replay->poses.size()) {
+    print_replay_stats();
+    glfwSetWindowShouldClose(window.get_window(), true);
+  }
+}
+
+// the clock only starts once the first pose is loaded, from then on every frame
+// showing a hole in the world is counted
+void VoxelEngine::update_realtime_replay() {
+  auto& poses = camera_replay->poses;
+  if (replay_pose == poses.size()) {
+    return;
+  }
+  if (replay_start_time < 0.0) {
+    if (!chunk_manager.is_loading()) {
+      replay_start_time = current_frame;
+      // the chunks around the first pose aren't part of the flight
+      chunk_manager.reset_load_latency_stats();
+    }
+    return;
+  }
+
+  replay_frames++;
+  if (chunk_manager.get_missing_chunk_count() > 0) {
+    replay_missing_frames++;
+  }
+
+  double elapsed = (current_frame - replay_start_time) /
+                   CameraRecorder::RECORD_INTERVAL;
+  replay_pose = std::min((size_t)elapsed, poses.size() - 1);
+  replay_fraction = elapsed - replay_pose;
+  if (replay_pose == poses.size() - 1) {
+    replay_pose = poses.size();
+    auto latency = chunk_manager.get_total_load_latency_stats();
+    PRINT("flight: {} of {} frames had chunks missing from view ({:.01f}%), "
+          "prefetch {}\n",
+          replay_missing_frames, replay_frames,
+          100.0 * replay_missing_frames / std::max(replay_frames, 1),
+          chunk_manager.is_prefetch() ? "on" : "off");
+    PRINT("flight: load latency {:.01f}ms avg, {:.01f}ms worst over {} "
+          "chunks, {} order\n",
+          latency.average_ms, latency.worst_ms,
+          chunk_manager.get_load_latency_count(),
+          chunk_manager.is_row_order() ? "row" : "nearest first");
+    glfwSetWindowShouldClose(window.get_window(), true);
+  }
+}
+
+CameraPose VoxelEngine::get_replay_pose() const {
+  auto& poses = camera_replay->poses;
+  if (!replay_realtime || replay_pose + 1 >= poses.size()) {
+    return poses[replay_pose];
+  }
+  return lerp_pose(poses[replay_pose], poses[replay_pose + 1],
+                   replay_fraction);
+}
+
+void VoxelEngine::print_replay_stats() {
+  size_t frustum_sections = 0;
+  size_t connected_sections = 0;
+  size_t drawn_sections = 0;
+  double pass_time = 0.0;
+  for (size_t i = 0; i < replay_stats.size(); i++) {
+    auto& stats = replay_stats[i];
+    size_t caved = stats.frustum_sections - stats.connected_sections;
+    size_t occluded = stats.connected_sections - stats.drawn_sections;
+    PRINT("pose {}: {} of {} sections culled ({} caved, {} occluded), "
+          "{:.02f}ms\n",
+          i, caved + occluded, stats.frustum_sections, caved, occluded,
+          stats.pass_time);
+    frustum_sections += stats.frustum_sections;
+    connected_sections += stats.connected_sections;
+    drawn_sections += stats.drawn_sections;
+    pass_time += stats.pass_time;
+  }
+  auto percent = [&](size_t count) {
+    return 100.0 * count / std::max<size_t>(frustum_sections, 1);
+  };
+  size_t caved = frustum_sections - connected_sections;
+  size_t occluded = connected_sections - drawn_sections;
+  PRINT("cull rate: of {} sections in the frustum, {} caved ({:.01f}%) and "
+        "{} occluded ({:.01f}%), {:.02f}ms per pass over {} poses\n",
+        frustum_sections, caved, percent(caved), occluded, percent(occluded),
+        pass_time / replay_stats.size(), replay_stats.size());
+}
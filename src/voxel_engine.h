@@ -1,8 +1,38 @@
 #pragma once
+#include "camera_path.h"
 #include "chunk_manager.h"
+#include "engine_config.h"
 #include "player_camera.h"
 #include "window.h"
 
+// set from the command line, see main.cpp
+struct EngineOptions {
+  // world seed, random when not given
+  std::optional<uint32_t> seed;
+  EngineConfig config;
+  // camera poses are saved to this file while playing
+  std::optional<std::string> record_path;
+  // flies through these poses instead of taking input, then prints how many
+  // sections cave and occlusion culling removed and exits
+  std::optional<CameraPath> replay;
+  // replays the poses at the speed they were recorded at instead, and prints
+  // how many frames had chunks missing from view and the load latency
+  bool replay_realtime = false;
+  // generate chunks ahead of the camera, past the load radius
+  bool prefetch = true;
+  // hand out generation and mesh jobs in row order instead of nearest first,
+  // to compare load latencies against
+  bool row_order = false;
+};
+
+// culling results of a replayed pose, taken once every chunk in view is loaded
+struct ReplayStats {
+  size_t frustum_sections = 0;
+  size_t connected_sections = 0;
+  size_t drawn_sections = 0;
+  double pass_time = 0.0;
+};
+
 class VoxelEngine {
 private:
   Window window;
@@ -10,6 +40,20 @@ private:
   ChunkManager chunk_manager;
 
   bool show_wireframe = false;
+  // released with tab, so the overlay's controls can be used
+  bool mouse_captured = true;
+
+  std::optional<CameraRecorder> camera_recorder;
+  std::optional<CameraPath> camera_replay;
+  size_t replay_pose = 0;
+  std::vector<ReplayStats> replay_stats;
+  bool replay_realtime = false;
+  // of the way from replay_pose to the next one, only in realtime replays
+  float replay_fraction = 0.0f;
+  // negative until everything around the first pose is loaded
+  double replay_start_time = -1.0;
+  int replay_frames = 0;
+  int replay_missing_frames = 0;
 
   // frame time variables
   double delta_time = 0.0f;
@@ -17,10 +61,15 @@ private:
   double last_frame = 0.0f;
 
 public:
-  VoxelEngine(int viewport_width, int viewport_height);
+  VoxelEngine(int viewport_width, int viewport_height,
+              const EngineOptions& options);
 
   void run();
   void handle_input();
+  void update_camera_path();
+  void update_realtime_replay();
+  CameraPose get_replay_pose() const;
+  void print_replay_stats();
   void toggle_wireframe() {
     static constexpr uint32_t map[2] = {GL_FILL, GL_LINE};
     show_wireframe = !show_wireframe;
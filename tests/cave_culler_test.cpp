@@ -0,0 +1,251 @@
+#include "cave_culler.h"
+#include "chunk.h"
+#include "terrain_generator.h"
+#include <gtest/gtest.h>
+#include <glm/gtc/matrix_transform.hpp>
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <memory>
+#include <numeric>
+#include <random>
+#include <utility>
+#include <vector>
+
+// face connectivity against a union find over a section's open voxels, and
+// the cave culler's search against rays marched from the camera: a ray on
+// screen must never pass through open voxels into a section that wasn't
+// reached
+
+static constexpr int RADIUS = 6;
+
+// like Chunk::get_voxel, through the section's storage
+static VoxelType get_voxel_type(const Chunk& chunk, int x, int y, int z) {
+  return chunk.get_section(y / SECTION_SIZE)
+      .voxels.get(x + z * CHUNK_WIDTH +
+                  (y % SECTION_SIZE) * CHUNK_WIDTH * CHUNK_DEPTH);
+}
+
+// generated terrain with random tunnels carved into it, a ring wider than the
+// culler's radius so the search never runs off the loaded chunks
+class CaveCullerTest : public testing::Test {
+protected:
+  TerrainGenerator terrain_generator{1234};
+  std::map<std::pair<int, int>, std::unique_ptr<Chunk>> chunks;
+  std::mt19937 rng{3};
+
+  void SetUp() override {
+    std::uniform_int_distribution<int> coordinate(0, 15);
+    for (auto x = -RADIUS - 1; x <= RADIUS + 1; x++) {
+      for (auto z = -RADIUS - 1; z <= RADIUS + 1; z++) {
+        auto chunk = std::make_unique<Chunk>(ChunkPos{.x = x, .z = z},
+                                             terrain_generator);
+        chunk->mark_queued();
+        chunk->generate();
+        for (auto tunnel = 0; tunnel < 4; tunnel++) {
+          int p[3] = {coordinate(rng), 20 + coordinate(rng) * 5,
+                      coordinate(rng)};
+          for (auto step = 0; step < 40; step++) {
+            chunk->set_voxel(p[0], p[1], p[2], VoxelType::AIR);
+            int axis = rng() % 3;
+            p[axis] += rng() % 2 ? 1 : -1;
+            p[0] = std::clamp(p[0], 0, CHUNK_WIDTH - 1);
+            p[1] = std::clamp(p[1], 1, CHUNK_HEIGHT - 6);
+            p[2] = std::clamp(p[2], 0, CHUNK_DEPTH - 1);
+          }
+        }
+        chunks[{x, z}] = std::move(chunk);
+      }
+    }
+  }
+
+  Chunk* find(ChunkPos w) {
+    auto it = chunks.find({w.x, w.z});
+    return it == chunks.end() ? nullptr : it->second.get();
+  }
+
+  // whether the voxel at a world position is opaque, nothing loaded is open
+  bool is_solid(glm::vec3 p) {
+    if (p.y < 0 || p.y >= CHUNK_HEIGHT) {
+      return false;
+    }
+    auto w = ChunkPos{.x = (int)std::floor(p.x / CHUNK_WIDTH),
+                      .z = (int)std::ceil(p.z / CHUNK_DEPTH)};
+    auto* chunk = find(w);
+    if (!chunk) {
+      return false;
+    }
+    int x = (int)std::floor(p.x) - w.x * CHUNK_WIDTH;
+    int z = (int)std::floor(w.z * CHUNK_DEPTH - p.z);
+    if (x < 0 || x >= CHUNK_WIDTH || z < 0 || z >= CHUNK_DEPTH) {
+      return false;
+    }
+    return is_opaque(get_voxel_type(*chunk, x, (int)std::floor(p.y), z));
+  }
+};
+
+// the faces each group of connected open voxels touches, every pair of them
+// connected
+static uint16_t get_connectivity_by_union_find(const Chunk& chunk,
+                                               int section) {
+  auto index = [](int x, int y, int z) {
+    return x + z * CHUNK_WIDTH + y * CHUNK_WIDTH * CHUNK_DEPTH;
+  };
+  auto is_open = [&](int x, int y, int z) {
+    return !is_opaque(
+        get_voxel_type(chunk, x, section * SECTION_SIZE + y, z));
+  };
+  std::vector<int> parents(SECTION_VOLUME);
+  std::iota(parents.begin(), parents.end(), 0);
+  auto find_root = [&](int i) {
+    while (parents[i] != i) {
+      i = parents[i] = parents[parents[i]];
+    }
+    return i;
+  };
+
+  for (auto y = 0; y < SECTION_SIZE; y++) {
+    for (auto z = 0; z < SECTION_SIZE; z++) {
+      for (auto x = 0; x < SECTION_SIZE; x++) {
+        if (!is_open(x, y, z)) {
+          continue;
+        }
+        int root = find_root(index(x, y, z));
+        if (x + 1 < SECTION_SIZE && is_open(x + 1, y, z)) {
+          parents[find_root(index(x + 1, y, z))] = root;
+        }
+        if (y + 1 < SECTION_SIZE && is_open(x, y + 1, z)) {
+          parents[find_root(index(x, y + 1, z))] = find_root(root);
+        }
+        if (z + 1 < SECTION_SIZE && is_open(x, y, z + 1)) {
+          parents[find_root(index(x, y, z + 1))] = find_root(root);
+        }
+      }
+    }
+  }
+
+  std::map<int, int> faces_by_root;
+  for (auto y = 0; y < SECTION_SIZE; y++) {
+    for (auto z = 0; z < SECTION_SIZE; z++) {
+      for (auto x = 0; x < SECTION_SIZE; x++) {
+        if (!is_open(x, y, z)) {
+          continue;
+        }
+        int faces = 0;
+        faces |= (x == 0) << (int)BlockFaces::LEFT;
+        faces |= (x == SECTION_SIZE - 1) << (int)BlockFaces::RIGHT;
+        faces |= (y == 0) << (int)BlockFaces::BOTTOM;
+        faces |= (y == SECTION_SIZE - 1) << (int)BlockFaces::TOP;
+        faces |= (z == 0) << (int)BlockFaces::FRONT;
+        faces |= (z == SECTION_SIZE - 1) << (int)BlockFaces::BACK;
+        faces_by_root[find_root(index(x, y, z))] |= faces;
+      }
+    }
+  }
+
+  uint16_t connectivity = 0;
+  for (auto [root, faces] : faces_by_root) {
+    for (auto a = 0; a < 6; a++) {
+      for (auto b = a + 1; b < 6; b++) {
+        if ((faces >> a) & (faces >> b) & 1) {
+          connectivity |= 1 << get_face_pair_bit((BlockFaces)a, (BlockFaces)b);
+        }
+      }
+    }
+  }
+  return connectivity;
+}
+
+TEST_F(CaveCullerTest, ConnectivityMatchesUnionFind) {
+  for (auto& [pos, chunk] : chunks) {
+    for (auto s = 0; s < SECTIONS_PER_CHUNK; s++) {
+      EXPECT_EQ(chunk->get_face_connectivity(s),
+                get_connectivity_by_union_find(*chunk, s))
+          << "chunk " << pos.first << ", " << pos.second << ", section " << s;
+    }
+  }
+}
+
+TEST_F(CaveCullerTest, RaysNeverReachCulledSections) {
+  auto projection =
+      glm::perspective(glm::radians(70.0f), 16.0f / 9.0f, 0.1f, 1000.0f);
+  std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+  CaveCuller cave_culler(RADIUS);
+  int poses = 0;
+  size_t culled = 0;
+  for (auto attempt = 0; attempt < 60; attempt++) {
+    // anywhere from deep underground to above the terrain
+    auto eye = glm::vec3((unit(rng) - 0.5f) * 60, 10 + unit(rng) * 140,
+                         (unit(rng) - 0.5f) * 60);
+    if (is_solid(eye)) {
+      continue;
+    }
+    poses++;
+    float yaw = unit(rng) * 6.2831853f;
+    float pitch = (unit(rng) - 0.5f) * 1.2f;
+    auto direction = glm::vec3(std::cos(yaw) * std::cos(pitch),
+                               std::sin(pitch),
+                               std::sin(yaw) * std::cos(pitch));
+    auto view_projection =
+        projection *
+        glm::lookAt(eye, eye + direction, glm::vec3(0.0f, 1.0f, 0.0f));
+    Frustum frustum;
+    frustum.create_frustum_from_camera(view_projection);
+
+    auto camera_chunk = ChunkPos{.x = (int)std::floor(eye.x / CHUNK_WIDTH),
+                                 .z = (int)std::ceil(eye.z / CHUNK_DEPTH)};
+    cave_culler.find_reachable(camera_chunk, eye.y, frustum,
+                               [&](ChunkPos w, int section) {
+                                 auto* chunk = find(w);
+                                 return chunk
+                                            ? chunk->get_face_connectivity(
+                                                  section)
+                                            : ALL_FACES_CONNECTED;
+                               });
+    for (auto dx = -RADIUS; dx <= RADIUS; dx++) {
+      for (auto dz = -RADIUS; dz <= RADIUS; dz++) {
+        for (auto s = 0; s < SECTIONS_PER_CHUNK; s++) {
+          culled += !cave_culler.is_reachable(
+              ChunkPos{.x = camera_chunk.x + dx, .z = camera_chunk.z + dz},
+              s);
+        }
+      }
+    }
+
+    // marched in small steps until it hits an opaque voxel or leaves the
+    // culler's area. Only the parts on screen have to be reached
+    for (auto ray = 0; ray < 400; ray++) {
+      auto ray_direction = glm::normalize(
+          direction + glm::vec3(unit(rng) - 0.5f, unit(rng) - 0.5f,
+                                unit(rng) - 0.5f) *
+                          0.6f);
+      auto p = eye;
+      for (auto step = 0; step < 4000; step++) {
+        p += ray_direction * 0.05f;
+        auto w = ChunkPos{.x = (int)std::floor(p.x / CHUNK_WIDTH),
+                          .z = (int)std::ceil(p.z / CHUNK_DEPTH)};
+        if (p.y < 0 || p.y >= CHUNK_HEIGHT ||
+            std::abs(w.x - camera_chunk.x) > RADIUS ||
+            std::abs(w.z - camera_chunk.z) > RADIUS) {
+          break;
+        }
+        auto clip = view_projection * glm::vec4(p, 1.0f);
+        bool on_screen = clip.w > 0 && std::abs(clip.x) <= clip.w &&
+                         std::abs(clip.y) <= clip.w;
+        if (on_screen) {
+          int section = (int)std::floor(p.y / SECTION_SIZE);
+          ASSERT_TRUE(cave_culler.is_reachable(w, section))
+              << "ray " << ray << " at pose " << attempt << " reached chunk "
+              << w.x << ", " << w.z << ", section " << section;
+        }
+        if (is_solid(p)) {
+          break;
+        }
+      }
+    }
+  }
+  // some poses have to be in the open and some underground for this to mean
+  // anything
+  EXPECT_GT(poses, 10);
+  EXPECT_GT(culled, 0u);
+}
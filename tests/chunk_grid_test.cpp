@@ -0,0 +1,78 @@
+#include "chunk_grid.h"
+#include "terrain_generator.h"
+#include <gtest/gtest.h>
+#include <map>
+#include <utility>
+
+// chunks have to stay where they are, and findable, while the grid's window
+// moves and changes size under them (the view distance changing)
+
+namespace {
+
+// an 11x11 area of chunks around the origin, more than the grid's window
+class ChunkGridTest : public testing::Test {
+protected:
+  static constexpr int AREA_RADIUS = 5;
+
+  TerrainGenerator terrain_generator{1};
+  ChunkGrid grid{3};
+  std::map<std::pair<int, int>, Chunk*> chunks;
+
+  void SetUp() override {
+    grid.recentre(ChunkPos{.x = 0, .z = 0});
+    for (auto x = -AREA_RADIUS; x <= AREA_RADIUS; x++) {
+      for (auto z = -AREA_RADIUS; z <= AREA_RADIUS; z++) {
+        auto w = ChunkPos{.x = x, .z = z};
+        auto [chunk, inserted] = grid.try_emplace(w, w, terrain_generator);
+        ASSERT_TRUE(inserted);
+        chunks[{x, z}] = chunk;
+      }
+    }
+  }
+
+  void expect_every_chunk_found() {
+    for (auto [pos, chunk] : chunks) {
+      auto w = ChunkPos{.x = pos.first, .z = pos.second};
+      EXPECT_EQ(grid.find(w), chunk) << "chunk " << w.x << ", " << w.z;
+    }
+    EXPECT_EQ(grid.get_chunk_count(), chunks.size());
+
+    size_t count = 0;
+    grid.for_each([&](ChunkPos w, Chunk& chunk) {
+      EXPECT_EQ(chunk.get_pos(), w);
+      EXPECT_EQ((chunks[{w.x, w.z}]), &chunk);
+      count++;
+    });
+    EXPECT_EQ(count, chunks.size());
+  }
+};
+
+} // namespace
+
+TEST_F(ChunkGridTest, KeepsChunksWhenResized) {
+  for (auto radius : {1, 6, 2, 3}) {
+    grid.resize(radius);
+    expect_every_chunk_found();
+  }
+}
+
+TEST_F(ChunkGridTest, KeepsChunksWhenRecentred) {
+  for (auto center : {ChunkPos{.x = 3, .z = -2}, ChunkPos{.x = -9, .z = 4},
+                      ChunkPos{.x = 0, .z = 0}}) {
+    grid.recentre(center);
+    expect_every_chunk_found();
+  }
+}
+
+TEST_F(ChunkGridTest, NothingFoundOnceErased) {
+  auto w = ChunkPos{.x = 1, .z = 1};
+  grid.erase(w);
+  chunks.erase({w.x, w.z});
+  EXPECT_EQ(grid.find(w), nullptr);
+  // far outside the window
+  auto far = ChunkPos{.x = -AREA_RADIUS, .z = AREA_RADIUS};
+  grid.erase(far);
+  chunks.erase({far.x, far.z});
+  EXPECT_EQ(grid.find(far), nullptr);
+  expect_every_chunk_found();
+}
@@ -0,0 +1,120 @@
+#include "engine_config.h"
+#include <gtest/gtest.h>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+// reading engine.cfg files: keys, comments and defaults, and the malformed or
+// out of range values that have to stop the engine instead of being used.
+// PANIC exits with 1
+
+namespace {
+
+// a config file with the given text, removed again with the fixture
+class EngineConfigTest : public testing::Test {
+protected:
+  std::filesystem::path path;
+
+  void SetUp() override {
+    auto* test = testing::UnitTest::GetInstance()->current_test_info();
+    path = std::filesystem::temp_directory_path() /
+           (std::string("engine_config_test_") + test->name() + ".cfg");
+  }
+
+  void TearDown() override {
+    std::filesystem::remove(path);
+  }
+
+  std::string write(const std::string& text) {
+    std::ofstream(path) << text;
+    return path.string();
+  }
+};
+
+} // namespace
+
+TEST_F(EngineConfigTest, ReadsKeys) {
+  auto config = load_engine_config(
+      write("# comment\n"
+            "view_distance 20 # after a value\n"
+            "\n"
+            "   min_view_distance   6\n"
+            "auto_view_distance 0\n"
+            "smooth_terrain 1\n"
+            "target_frame_ms 8.3\n"
+            "resident_megabytes 4096\n"
+            "gpu_megabytes 64\n"
+            "max_gpu_megabytes 512\n"));
+  EXPECT_EQ(config.view_distance, 20);
+  EXPECT_EQ(config.min_view_distance, 6);
+  EXPECT_FALSE(config.auto_view_distance);
+  EXPECT_TRUE(config.smooth_terrain);
+  EXPECT_DOUBLE_EQ(config.target_frame_ms, 8.3);
+  EXPECT_EQ(config.resident_megabytes, 4096u);
+  EXPECT_EQ(config.gpu_megabytes, 64);
+  EXPECT_EQ(config.max_gpu_megabytes, 512);
+  // not given
+  EXPECT_EQ(config.load_margin, EngineConfig{}.load_margin);
+  EXPECT_EQ(config.unload_margin, EngineConfig{}.unload_margin);
+}
+
+TEST_F(EngineConfigTest, MissingFileGivesDefaults) {
+  auto config = load_engine_config(path.string());
+  auto defaults = EngineConfig{};
+  EXPECT_EQ(config.view_distance, defaults.view_distance);
+  EXPECT_EQ(config.min_view_distance, defaults.min_view_distance);
+  EXPECT_EQ(config.auto_view_distance, defaults.auto_view_distance);
+  EXPECT_EQ(config.smooth_terrain, defaults.smooth_terrain);
+  EXPECT_EQ(config.resident_megabytes, defaults.resident_megabytes);
+}
+
+TEST_F(EngineConfigTest, ShippedConfigIsValid) {
+  auto shipped = std::filesystem::path(__FILE__).parent_path() / ".." /
+                 "src" / "assets" / "engine.cfg";
+  ASSERT_TRUE(std::filesystem::exists(shipped));
+  auto config = load_engine_config(shipped.string());
+  // the defaults in the struct and the shipped file are meant to agree
+  auto defaults = EngineConfig{};
+  EXPECT_EQ(config.view_distance, defaults.view_distance);
+  EXPECT_EQ(config.min_view_distance, defaults.min_view_distance);
+  EXPECT_EQ(config.auto_view_distance, defaults.auto_view_distance);
+  EXPECT_EQ(config.smooth_terrain, defaults.smooth_terrain);
+  EXPECT_EQ(config.resident_megabytes, defaults.resident_megabytes);
+  EXPECT_EQ(config.gpu_megabytes, defaults.gpu_megabytes);
+  EXPECT_EQ(config.max_gpu_megabytes, defaults.max_gpu_megabytes);
+}
+
+TEST_F(EngineConfigTest, RejectsMalformedValues) {
+  for (auto* text : {"view_distance twelve\n", "view_distance 12 13\n",
+                     "view_distance\n", "target_frame_ms 16.7ms\n",
+                     "no_such_key 1\n"}) {
+    EXPECT_EXIT(load_engine_config(write(text)), testing::ExitedWithCode(1),
+                "")
+        << text;
+  }
+}
+
+TEST_F(EngineConfigTest, RejectsNegativeUnsignedValues) {
+  // streams would wrap these around to huge sizes
+  EXPECT_EXIT(load_engine_config(write("resident_megabytes -1\n")),
+              testing::ExitedWithCode(1), "");
+  EXPECT_EXIT(load_engine_config(write("resident_megabytes   -256\n")),
+              testing::ExitedWithCode(1), "");
+  // and past the most that fits in a byte count
+  EXPECT_EXIT(load_engine_config(write("resident_megabytes " +
+                                       std::to_string(SIZE_MAX / 1024) + "\n")),
+              testing::ExitedWithCode(1), "");
+}
+
+TEST_F(EngineConfigTest, RejectsOutOfRangeValues) {
+  for (auto* text : {"view_distance 33\n", "min_view_distance 0\n",
+                     "min_view_distance 13\n", "load_margin 0\n",
+                     "unload_margin -1\n", "target_frame_ms 0\n",
+                     "resident_megabytes 0\n", "gpu_megabytes 0\n",
+                     "gpu_megabytes 2000\n", "max_gpu_megabytes 4096\n"}) {
+    EXPECT_EXIT(load_engine_config(write(text)), testing::ExitedWithCode(1),
+                "")
+        << text;
+  }
+}
@@ -0,0 +1,113 @@
+#include "frustum.h"
+#include <gtest/gtest.h>
+#include <cmath>
+#include <random>
+#include <vector>
+
+// the batched (avx on cpus that have it) frustum test against the one box at a
+// time scalar path, and the positive vertex test against testing every corner
+
+// boxes within this of a plane may go either way, the scalar path can be
+// contracted into fmas and round differently
+static constexpr float EPSILON = 1e-3f;
+
+static BoundingBox grow_box(const BoundingBox& bb, float amount) {
+  return BoundingBox{.min = bb.min - glm::vec3(amount),
+                     .max = bb.max + glm::vec3(amount)};
+}
+
+// the section boxes of a (2 * radius)^2 chunk area
+static BoundingBoxList create_section_boxes(int radius) {
+  BoundingBoxList boxes;
+  for (auto x = -radius; x < radius; x++) {
+    for (auto z = -radius; z < radius; z++) {
+      for (auto section = 0; section < SECTIONS_PER_CHUNK; section++) {
+        float x_offset = x * CHUNK_WIDTH;
+        float z_offset = z * CHUNK_DEPTH;
+        boxes.push_back(BoundingBox{
+            .min = glm::vec3(x_offset, section * SECTION_SIZE,
+                             z_offset - CHUNK_DEPTH),
+            .max = glm::vec3(x_offset + CHUNK_WIDTH,
+                             (section + 1) * SECTION_SIZE, z_offset)});
+      }
+    }
+  }
+  return boxes;
+}
+
+TEST(FrustumTest, BatchedMatchesScalar) {
+  // 26 * 26 chunks of 16 sections plus one odd box, not a multiple of 8 so
+  // the scalar tail is covered too
+  auto boxes = create_section_boxes(13);
+  boxes.push_back(BoundingBox{.min = glm::vec3(1.5f, 2.5f, -3.5f),
+                              .max = glm::vec3(2.5f, 80.0f, 0.5f)});
+  ASSERT_GE(boxes.size(), 10000u);
+  ASSERT_NE(boxes.size() % 8, 0u);
+
+  std::mt19937 rng(1);
+  std::uniform_real_distribution<float> position(-150.0f, 150.0f);
+  std::uniform_real_distribution<float> angle(0.0f, 6.2831853f);
+  auto projection =
+      glm::perspective(glm::radians(70.0f), 16.0f / 9.0f, 0.1f, 500.0f);
+
+  Frustum frustum;
+  std::vector<uint64_t> visible;
+  size_t visible_count = 0;
+  for (auto pose = 0; pose < 100; pose++) {
+    float yaw = angle(rng);
+    float pitch = (angle(rng) - 3.1415926f) / 4.0f;
+    auto eye = glm::vec3(position(rng), 40.0f + position(rng) / 2,
+                         position(rng));
+    auto direction = glm::vec3(std::cos(yaw) * std::cos(pitch),
+                               std::sin(pitch),
+                               std::sin(yaw) * std::cos(pitch));
+    frustum.create_frustum_from_camera(
+        projection *
+        glm::lookAt(eye, eye + direction, glm::vec3(0.0f, 1.0f, 0.0f)));
+    frustum.test_bounding_boxes(boxes, visible);
+    ASSERT_EQ(visible.size(), (boxes.size() + 63) / 64);
+
+    for (size_t i = 0; i < boxes.size(); i++) {
+      auto bb = boxes.get(i);
+      bool inside = (visible[i / 64] >> (i % 64)) & 1;
+      visible_count += inside;
+      if (inside == frustum.test_bounding_box(bb)) {
+        continue;
+      }
+      // only allowed when the box touches a plane
+      EXPECT_TRUE(frustum.test_bounding_box(grow_box(bb, EPSILON)) &&
+                  !frustum.test_bounding_box(grow_box(bb, -EPSILON)))
+          << "box " << i << " at pose " << pose;
+    }
+  }
+  // the poses have to see something for the comparison to mean anything
+  EXPECT_GT(visible_count, 0u);
+}
+
+TEST(FrustumTest, PositiveVertexMatchesCorners) {
+  std::mt19937 rng(2);
+  std::uniform_real_distribution<float> normal(-1.0f, 1.0f);
+  std::uniform_real_distribution<float> position(-100.0f, 100.0f);
+  std::uniform_real_distribution<float> size(0.0f, 32.0f);
+
+  for (auto i = 0; i < 100000; i++) {
+    Plane plane{.a = normal(rng),
+                .b = normal(rng),
+                .c = normal(rng),
+                .d = position(rng)};
+    auto min = glm::vec3(position(rng), position(rng), position(rng));
+    auto bb = BoundingBox{
+        .min = min, .max = min + glm::vec3(size(rng), size(rng), size(rng))};
+
+    float furthest = -INFINITY;
+    for (auto corner = 0; corner < 8; corner++) {
+      auto point = glm::vec3(corner & 1 ? bb.max.x : bb.min.x,
+                             corner & 2 ? bb.max.y : bb.min.y,
+                             corner & 4 ? bb.max.z : bb.min.z);
+      furthest = std::max(furthest, plane.distance_to_point(point));
+    }
+    if (std::abs(furthest) > EPSILON) {
+      EXPECT_EQ(plane.bounding_box_test(bb), furthest >= 0) << "plane " << i;
+    }
+  }
+}
@@ -0,0 +1,70 @@
+#include "gpu_allocator.h"
+#include <gtest/gtest.h>
+
+// the mesh buffer's allocator: alignment, coalescing on release, and growing
+// the buffer in place
+
+TEST(GpuAllocatorTest, RoundsUpToAlignment) {
+  GpuAllocator allocator(100, 4);
+  auto a = allocator.allocate(5);
+  auto b = allocator.allocate(1);
+  ASSERT_TRUE(a && b);
+  EXPECT_EQ(a->size, 8);
+  EXPECT_EQ(b->offset, 8);
+  EXPECT_EQ(allocator.get_bytes_in_use(), 12);
+}
+
+TEST(GpuAllocatorTest, CoalescesReleasedRanges) {
+  GpuAllocator allocator(96, 4);
+  auto a = allocator.allocate(32);
+  auto b = allocator.allocate(32);
+  auto c = allocator.allocate(32);
+  ASSERT_TRUE(a && b && c);
+  EXPECT_FALSE(allocator.allocate(4));
+
+  allocator.release(*a);
+  allocator.release(*c);
+  // two free ranges of 32, neither big enough
+  EXPECT_FALSE(allocator.allocate(64));
+  allocator.release(*b);
+  auto all = allocator.allocate(96);
+  ASSERT_TRUE(all);
+  EXPECT_EQ(all->offset, 0);
+  EXPECT_EQ(allocator.get_bytes_in_use(), 96);
+}
+
+TEST(GpuAllocatorTest, GrowMergesWithTrailingFreeRange) {
+  GpuAllocator allocator(100, 4);
+  auto a = allocator.allocate(96);
+  ASSERT_TRUE(a);
+  EXPECT_FALSE(allocator.allocate(8));
+
+  // the 4 free bytes at the old end and the new 100 are one range
+  allocator.grow(200);
+  EXPECT_EQ(allocator.get_capacity(), 200);
+  auto b = allocator.allocate(104);
+  ASSERT_TRUE(b);
+  EXPECT_EQ(b->offset, 96);
+
+  allocator.release(*a);
+  allocator.release(*b);
+  auto all = allocator.allocate(200);
+  ASSERT_TRUE(all);
+  EXPECT_EQ(all->offset, 0);
+}
+
+TEST(GpuAllocatorTest, GrowWhenFull) {
+  GpuAllocator allocator(100, 4);
+  ASSERT_TRUE(allocator.allocate(100));
+  // rounded down to the alignment
+  allocator.grow(163);
+  EXPECT_EQ(allocator.get_capacity(), 160);
+  auto a = allocator.allocate(60);
+  ASSERT_TRUE(a);
+  EXPECT_EQ(a->offset, 100);
+  EXPECT_FALSE(allocator.allocate(4));
+
+  // never shrinks
+  allocator.grow(50);
+  EXPECT_EQ(allocator.get_capacity(), 160);
+}
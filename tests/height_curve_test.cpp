@@ -0,0 +1,62 @@
+#include "height_curve.h"
+#include "terrain_generator.h"
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+// the LINEAR curve against the straight segments terrain heights were
+// evaluated with before the curve was tabled (LerpPoints::interpolate)
+
+// the last segment whose ends contain x wins, like LerpPoints
+static float interpolate_segments(const std::vector<CurvePoint>& points,
+                                  float x) {
+  CurvePoint lower = {.x = -1, .y = -1};
+  CurvePoint upper = {.x = -1, .y = -1};
+  for (size_t i = 0; i < points.size() - 1; i++) {
+    if (points[i].x <= x && x <= points[i + 1].x) {
+      lower = points[i];
+      upper = points[i + 1];
+    }
+  }
+  float gradient = (upper.y - lower.y) / (upper.x - lower.x);
+  return lower.y + (x - lower.x) * gradient;
+}
+
+TEST(HeightCurveTest, LinearMatchesStraightSegments) {
+  std::vector<CurvePoint> terrain_points(
+      TerrainGenerator::HEIGHT_CURVE_POINTS.begin(),
+      TerrainGenerator::HEIGHT_CURVE_POINTS.end());
+  // the terrain's curve, and with control points off the table's steps
+  std::vector<std::vector<CurvePoint>> curves = {terrain_points};
+  for (auto extra : {CurvePoint{.x = -0.3f, .y = 70},
+                     CurvePoint{.x = 0.7071f, .y = 101.5f}}) {
+    auto points = terrain_points;
+    points.push_back(extra);
+    std::sort(points.begin(), points.end(),
+              [](const auto& a, const auto& b) { return a.x < b.x; });
+    curves.push_back(points);
+  }
+
+  for (auto& points : curves) {
+    HeightCurve curve(points, CurveInterpolation::LINEAR);
+    // evenly spaced over the whole range
+    for (auto i = 0; i <= 1 << 20; i++) {
+      float x = -1.0f + 2.0f * i / (1 << 20);
+      ASSERT_EQ(curve.evaluate(x), interpolate_segments(points, x))
+          << "x = " << x;
+    }
+    // every float close to each control point, where the segment changes
+    for (auto& point : points) {
+      float x = point.x;
+      for (auto step = 0; step < 100000 && x > -1.0f; step++) {
+        x = std::nextafter(x, -2.0f);
+      }
+      for (auto step = 0; step < 200000 && x <= 1.0f; step++) {
+        ASSERT_EQ(curve.evaluate(x), interpolate_segments(points, x))
+            << "x = " << x;
+        x = std::nextafter(x, 2.0f);
+      }
+    }
+  }
+}
@@ -0,0 +1,226 @@
+#include "chunk.h"
+#include "terrain_generator.h"
+#include <gtest/gtest.h>
+#include <map>
+#include <memory>
+#include <set>
+#include <tuple>
+
+// every mesher has to cover exactly the surface the naive one does: the same
+// voxel faces, with the same textures. Quads are split back into the unit
+// faces they cover so merged and unmerged meshes can be compared
+
+// local voxel x, y, z, face, atlas index
+using UnitFace = std::tuple<int, int, int, int, int>;
+
+// per face: whether the face lies on the far side of its voxel along the
+// face normal's axis, see face_normals in chunk.cpp
+static constexpr bool FACE_ON_FAR_SIDE[6] = {
+    false, // BOTTOM
+    true,  // TOP
+    false, // LEFT
+    true,  // RIGHT
+    true,  // BACK
+    false, // FRONT
+};
+
+// matches the axes in chunk.cpp, the normal's axis is last
+static constexpr int FACE_NORMAL_AXIS[6] = {1, 1, 0, 0, 2, 2};
+
+static void unpack_vertex(PackedVertex vertex, int position[3], int& face,
+                          int& atlas_index) {
+  position[0] = vertex & 31;
+  position[1] = (vertex >> 5) & 511;
+  position[2] = (vertex >> 14) & 31;
+  face = (vertex >> 19) & 7;
+  atlas_index = (vertex >> 22) & 255;
+}
+
+// the unit faces covered by every quad of the chunk's mesh
+static std::multiset<UnitFace> get_unit_faces(const Chunk& chunk,
+                                              size_t& vertex_count) {
+  std::multiset<UnitFace> faces;
+  vertex_count = 0;
+  for (auto s = 0; s < SECTIONS_PER_CHUNK; s++) {
+    const auto& vertices = chunk.get_section(s).vertices_buffer;
+    vertex_count += vertices.size();
+    EXPECT_EQ(vertices.size() % 4, 0u);
+
+    for (size_t quad = 0; quad + 4 <= vertices.size(); quad += 4) {
+      int min[3] = {512, 512, 512};
+      int max[3] = {-1, -1, -1};
+      int face = -1;
+      int atlas_index = -1;
+      for (auto i = 0; i < 4; i++) {
+        int position[3];
+        int vertex_face;
+        int vertex_atlas_index;
+        unpack_vertex(vertices[quad + i], position, vertex_face,
+                      vertex_atlas_index);
+        if (i == 0) {
+          face = vertex_face;
+          atlas_index = vertex_atlas_index;
+        }
+        EXPECT_EQ(vertex_face, face);
+        EXPECT_EQ(vertex_atlas_index, atlas_index);
+        for (auto axis = 0; axis < 3; axis++) {
+          min[axis] = std::min(min[axis], position[axis]);
+          max[axis] = std::max(max[axis], position[axis]);
+        }
+      }
+
+      int normal_axis = FACE_NORMAL_AXIS[face];
+      EXPECT_EQ(min[normal_axis], max[normal_axis]);
+      int plane = min[normal_axis] - (FACE_ON_FAR_SIDE[face] ? 1 : 0);
+      min[normal_axis] = plane;
+      max[normal_axis] = plane + 1;
+      for (auto x = min[0]; x < max[0]; x++) {
+        for (auto y = min[1]; y < max[1]; y++) {
+          for (auto z = min[2]; z < max[2]; z++) {
+            EXPECT_EQ(y / SECTION_SIZE, s);
+            faces.emplace(x, y, z, face, atlas_index);
+          }
+        }
+      }
+    }
+  }
+  return faces;
+}
+
+class MesherTest : public ::testing::Test {
+protected:
+  // generated chunks span [-RADIUS, RADIUS] in x and z, so every chunk one
+  // step inside has all of its neighbours
+  static constexpr int RADIUS = 2;
+
+  TerrainGenerator terrain_generator{1234};
+  std::map<std::pair<int, int>, std::unique_ptr<Chunk>> chunks;
+
+  void SetUp() override {
+    for (auto x = -RADIUS; x <= RADIUS; x++) {
+      for (auto z = -RADIUS; z <= RADIUS; z++) {
+        auto chunk = std::make_unique<Chunk>(ChunkPos{.x = x, .z = z},
+                                             terrain_generator);
+        chunk->mark_queued();
+        chunk->generate();
+        chunks[{x, z}] = std::move(chunk);
+      }
+    }
+  }
+
+  Chunk& get_chunk(int x, int z) {
+    return *chunks.at({x, z});
+  }
+
+  // world coords: x grows with the chunk's x, z shrinks with the local z
+  void set_world_voxel(int x, int y, int z, VoxelType voxel_type) {
+    int chunk_x = x >= 0 ? x / CHUNK_WIDTH : -((-x - 1) / CHUNK_WIDTH) - 1;
+    int chunk_z =
+        z > 0 ? (z + CHUNK_DEPTH - 1) / CHUNK_DEPTH : -(-z / CHUNK_DEPTH);
+    get_chunk(chunk_x, chunk_z)
+        .set_voxel(x - chunk_x * CHUNK_WIDTH, y, chunk_z * CHUNK_DEPTH - z,
+                   voxel_type);
+  }
+
+  std::multiset<UnitFace> mesh(int x, int z, MeshingMode meshing_mode,
+                               size_t& vertex_count) {
+    auto& chunk = get_chunk(x, z);
+    chunk.request_mesh_creation(meshing_mode, get_chunk(x, z + 1),
+                                get_chunk(x, z - 1), get_chunk(x - 1, z),
+                                get_chunk(x + 1, z));
+    chunk.create_mesh();
+    return get_unit_faces(chunk, vertex_count);
+  }
+
+  // meshes every chunk with all its neighbours in each mode
+  void expect_same_surface() {
+    for (auto x = -RADIUS + 1; x <= RADIUS - 1; x++) {
+      for (auto z = -RADIUS + 1; z <= RADIUS - 1; z++) {
+        size_t naive_vertices;
+        auto naive = mesh(x, z, MeshingMode::NAIVE, naive_vertices);
+        EXPECT_FALSE(naive.empty());
+        for (auto meshing_mode : {MeshingMode::GREEDY, MeshingMode::BINARY}) {
+          size_t vertices;
+          auto faces = mesh(x, z, meshing_mode, vertices);
+          EXPECT_TRUE(faces == naive)
+              << get_meshing_mode_name(meshing_mode) << " mesh of chunk " << x
+              << ", " << z << " covers " << faces.size()
+              << " faces, naive covers " << naive.size();
+          EXPECT_LE(vertices, naive_vertices);
+        }
+      }
+    }
+  }
+};
+
+TEST_F(MesherTest, GeneratedTerrain) {
+  expect_same_surface();
+}
+
+TEST_F(MesherTest, MergesFlatTerrain) {
+  size_t naive_vertices;
+  size_t greedy_vertices;
+  mesh(0, 0, MeshingMode::NAIVE, naive_vertices);
+  mesh(0, 0, MeshingMode::GREEDY, greedy_vertices);
+  EXPECT_LT(greedy_vertices * 2, naive_vertices);
+}
+
+TEST_F(MesherTest, ChunkBorders) {
+  // pillars on both sides of every border of the middle chunk, one voxel
+  // either side of the border and right on it
+  for (auto y = 100; y < 140; y++) {
+    set_world_voxel(-1, y, -5, VoxelType::STONE);
+    set_world_voxel(0, y, -6, VoxelType::WOOD);
+    set_world_voxel(15, y, -5, VoxelType::DIRT);
+    set_world_voxel(16, y, -6, VoxelType::STONE);
+    set_world_voxel(5, y, 0, VoxelType::STONE);
+    set_world_voxel(6, y, 1, VoxelType::WOOD);
+    set_world_voxel(5, y, -15, VoxelType::DIRT);
+    set_world_voxel(6, y, -16, VoxelType::STONE);
+  }
+  // a wall along a border, so faces on both sides of it stay hidden
+  for (auto x = 0; x < CHUNK_WIDTH; x++) {
+    for (auto y = 100; y < 110; y++) {
+      set_world_voxel(x, y, 0, VoxelType::STONE);
+      set_world_voxel(x, y, 1, VoxelType::STONE);
+    }
+  }
+  // the top and bottom of the world
+  set_world_voxel(3, CHUNK_HEIGHT - 1, -3, VoxelType::STONE);
+  set_world_voxel(4, 0, -4, VoxelType::AIR);
+  expect_same_surface();
+}
+
+TEST_F(MesherTest, Water) {
+  // a pool dug into the ground across a chunk border, and a floating sheet
+  for (auto x = -4; x < 4; x++) {
+    for (auto z = -4; z < 4; z++) {
+      for (auto y = 80; y < 140; y++) {
+        set_world_voxel(x, y, z, y < 100 ? VoxelType::WATER : VoxelType::AIR);
+      }
+      set_world_voxel(x + 8, 150, z - 8, VoxelType::WATER);
+    }
+  }
+  // water meeting stone inside the pool
+  set_world_voxel(0, 90, 0, VoxelType::STONE);
+  expect_same_surface();
+}
+
+TEST_F(MesherTest, Tunnels) {
+  // 3x3 tunnels through the ground along x and z, crossing chunk borders and
+  // the section border at y = 48
+  for (auto i = -RADIUS * CHUNK_WIDTH; i < RADIUS * CHUNK_WIDTH; i++) {
+    for (auto a = 0; a < 3; a++) {
+      for (auto b = 0; b < 3; b++) {
+        set_world_voxel(i, 46 + a, -7 + b, VoxelType::AIR);
+        set_world_voxel(9 + a, 30 + b, i, VoxelType::AIR);
+      }
+    }
+  }
+  // a shaft down between them, and a single air pocket
+  for (auto y = 20; y < 60; y++) {
+    set_world_voxel(10, y, -6, VoxelType::AIR);
+  }
+  set_world_voxel(2, 20, -2, VoxelType::AIR);
+  expect_same_surface();
+}
@@ -0,0 +1,211 @@
+#include "occlusion_culler.h"
+#include <gtest/gtest.h>
+#include <glm/gtc/matrix_transform.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <random>
+#include <vector>
+
+// OcclusionCuller against a ray cast reference. A culled box must have no
+// point of its surface that the camera sees, with no occluder in the way
+
+namespace {
+
+static constexpr auto PASS_BUDGET = std::chrono::seconds(10);
+
+const glm::mat4 projection =
+    glm::perspective(glm::radians(70.0f), 16.0f / 9.0f, 0.1f, 1000.0f);
+
+glm::mat4 look(glm::vec3 eye, glm::vec3 direction) {
+  return projection *
+         glm::lookAt(eye, eye + direction, glm::vec3(0.0f, 1.0f, 0.0f));
+}
+
+// whether the segment from eye to just short of p passes through bb
+bool is_blocked(glm::vec3 eye, glm::vec3 p, const BoundingBox& bb) {
+  auto d = p - eye;
+  float t_enter = 0.0f;
+  float t_exit = 0.999f;
+  for (auto axis = 0; axis < 3; axis++) {
+    if (std::abs(d[axis]) < 1e-9f) {
+      if (eye[axis] <= bb.min[axis] || eye[axis] >= bb.max[axis]) {
+        return false;
+      }
+      continue;
+    }
+    float a = (bb.min[axis] - eye[axis]) / d[axis];
+    float b = (bb.max[axis] - eye[axis]) / d[axis];
+    t_enter = std::max(t_enter, std::min(a, b));
+    t_exit = std::min(t_exit, std::max(a, b));
+    if (t_enter > t_exit) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// whether a point on the surface of bb, on screen and not blocked by an
+// occluder, was found. A grid of points on every face plus random ones
+bool is_seen(const glm::mat4& view_projection, glm::vec3 eye,
+             const std::vector<BoundingBox>& occluders, const BoundingBox& bb,
+             std::mt19937& rng) {
+  static constexpr int GRID = 6;
+  std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+  auto is_point_seen = [&](glm::vec3 p) {
+    auto clip = view_projection * glm::vec4(p, 1.0f);
+    if (clip.w <= 0 || std::abs(clip.x) > clip.w ||
+        std::abs(clip.y) > clip.w) {
+      return false;
+    }
+    return std::none_of(occluders.begin(), occluders.end(),
+                        [&](auto& o) { return is_blocked(eye, p, o); });
+  };
+  for (auto axis = 0; axis < 3; axis++) {
+    for (auto side = 0; side < 2; side++) {
+      for (auto i = 0; i <= GRID + 4; i++) {
+        for (auto j = 0; j <= GRID; j++) {
+          float u = i <= GRID ? (float)i / GRID : unit(rng);
+          float v = (float)j / GRID;
+          glm::vec3 p;
+          p[axis] = side ? bb.max[axis] : bb.min[axis];
+          p[(axis + 1) % 3] = glm::mix(bb.min[(axis + 1) % 3],
+                                       bb.max[(axis + 1) % 3], u);
+          p[(axis + 2) % 3] = glm::mix(bb.min[(axis + 2) % 3],
+                                       bb.max[(axis + 2) % 3], v);
+          if (is_point_seen(p)) {
+            return true;
+          }
+        }
+      }
+    }
+  }
+  return false;
+}
+
+bool is_bit_set(const std::vector<uint64_t>& bits, size_t i) {
+  return (bits[i / 64] >> (i % 64)) & 1;
+}
+
+} // namespace
+
+TEST(OcclusionCullerTest, NeverCullsVisibleBoxes) {
+  // ground under a 21 * 21 chunk area with heights between 60 and 110, and
+  // the sections above it up to a little past the ground
+  static constexpr int RADIUS = 10;
+  std::vector<BoundingBox> ground;
+  BoundingBoxList sections;
+  for (auto x = -RADIUS; x <= RADIUS; x++) {
+    for (auto z = -RADIUS; z <= RADIUS; z++) {
+      float height =
+          60 + (int)(25.0f + 25.0f * std::sin(x * 0.5f) * std::cos(z * 0.4f));
+      float x_offset = x * CHUNK_WIDTH;
+      float z_offset = z * CHUNK_DEPTH;
+      ground.push_back(BoundingBox{
+          .min = glm::vec3(x_offset, 0.0f, z_offset - CHUNK_DEPTH),
+          .max = glm::vec3(x_offset + CHUNK_WIDTH, height, z_offset)});
+      for (auto s = 3; s * SECTION_SIZE < height + 8; s++) {
+        float top = std::min<float>((s + 1) * SECTION_SIZE, height + 8);
+        sections.push_back(BoundingBox{
+            .min = glm::vec3(x_offset, s * SECTION_SIZE,
+                             z_offset - CHUNK_DEPTH),
+            .max = glm::vec3(x_offset + CHUNK_WIDTH, top, z_offset)});
+      }
+    }
+  }
+
+  std::mt19937 rng(7);
+  std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+  OcclusionCuller culler;
+  size_t tested = 0;
+  size_t culled = 0;
+  for (auto pose = 0; pose < 50; pose++) {
+    float yaw = unit(rng) * 6.2831853f;
+    float pitch = (unit(rng) - 0.6f) * 0.8f;
+    auto eye = glm::vec3((unit(rng) - 0.5f) * 100, 80 + unit(rng) * 60,
+                         (unit(rng) - 0.5f) * 100);
+    // every 5th pose level with the top of some ground
+    if (pose % 5 == 0) {
+      eye.y = 60.0f + (pose % 50);
+    }
+    auto direction = glm::vec3(std::cos(yaw) * std::cos(pitch),
+                               std::sin(pitch),
+                               std::sin(yaw) * std::cos(pitch));
+    auto view_projection = look(eye, direction);
+
+    // like ChunkManager::add_occluder, not the ground the camera is in
+    std::vector<BoundingBox> occluders;
+    for (auto& bb : ground) {
+      if (!(eye.x >= bb.min.x && eye.x <= bb.max.x && eye.y <= bb.max.y &&
+            eye.z >= bb.min.z && eye.z <= bb.max.z)) {
+        occluders.push_back(bb);
+      }
+    }
+
+    ASSERT_TRUE(culler.begin_pass(view_projection, occluders, sections));
+    auto* visible = culler.wait_for_pass(PASS_BUDGET);
+    ASSERT_NE(visible, nullptr);
+    for (size_t i = 0; i < sections.size(); i++) {
+      tested++;
+      if (is_bit_set(*visible, i)) {
+        continue;
+      }
+      culled++;
+      EXPECT_FALSE(
+          is_seen(view_projection, eye, occluders, sections.get(i), rng))
+          << "section " << i << " at pose " << pose;
+    }
+  }
+  // the poses have to cull something for the comparison to mean anything
+  RecordProperty("culled_percent", (int)(100 * culled / tested));
+  EXPECT_GT(culled, tested / 20);
+}
+
+TEST(OcclusionCullerTest, SeesThroughGapsNarrowerThanAPixel) {
+  // two walls 100 away with a 0.02 wide slit between them, and a box behind
+  // the slit. A pixel there is about 1.1 wide
+  std::vector<BoundingBox> walls = {
+      BoundingBox{.min = glm::vec3(-50.0f, -50.0f, -101.0f),
+                  .max = glm::vec3(-0.01f, 50.0f, -100.0f)},
+      BoundingBox{.min = glm::vec3(0.01f, -50.0f, -101.0f),
+                  .max = glm::vec3(50.0f, 50.0f, -100.0f)},
+  };
+  BoundingBoxList boxes;
+  boxes.push_back(BoundingBox{.min = glm::vec3(-1.0f, -1.0f, -201.0f),
+                              .max = glm::vec3(1.0f, 1.0f, -200.0f)});
+  // and one that is hidden
+  boxes.push_back(BoundingBox{.min = glm::vec3(-20.0f, -1.0f, -201.0f),
+                              .max = glm::vec3(-18.0f, 1.0f, -200.0f)});
+
+  OcclusionCuller culler;
+  auto eye = glm::vec3(0.0f, 0.0f, 0.0f);
+  ASSERT_TRUE(culler.begin_pass(look(eye, glm::vec3(0.0f, 0.0f, -1.0f)),
+                                walls, boxes));
+  auto* visible = culler.wait_for_pass(PASS_BUDGET);
+  ASSERT_NE(visible, nullptr);
+  EXPECT_TRUE(is_bit_set(*visible, 0));
+  EXPECT_FALSE(is_bit_set(*visible, 1));
+}
+
+TEST(OcclusionCullerTest, OccludersReachingPastTheCamera) {
+  // ground the camera stands on the edge of, clipped at the near plane,
+  // hides what is below it and not what is above
+  std::vector<BoundingBox> ground = {
+      BoundingBox{.min = glm::vec3(-1.0f, -100.0f, -200.0f),
+                  .max = glm::vec3(200.0f, 0.0f, 200.0f)},
+  };
+  BoundingBoxList boxes;
+  boxes.push_back(BoundingBox{.min = glm::vec3(50.0f, -30.0f, -5.0f),
+                              .max = glm::vec3(60.0f, -20.0f, 5.0f)});
+  boxes.push_back(BoundingBox{.min = glm::vec3(50.0f, 0.5f, -5.0f),
+                              .max = glm::vec3(60.0f, 10.0f, 5.0f)});
+
+  OcclusionCuller culler;
+  auto eye = glm::vec3(0.0f, 2.0f, 0.0f);
+  ASSERT_TRUE(culler.begin_pass(look(eye, glm::vec3(1.0f, -0.3f, 0.0f)),
+                                ground, boxes));
+  auto* visible = culler.wait_for_pass(PASS_BUDGET);
+  ASSERT_NE(visible, nullptr);
+  EXPECT_FALSE(is_bit_set(*visible, 0));
+  EXPECT_TRUE(is_bit_set(*visible, 1));
+}
@@ -0,0 +1,91 @@
+#include "staging_allocator.h"
+#include <gtest/gtest.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+// the staging ring's allocator: ranges are freed in the order they were handed
+// out and only once their serial completes, and meshers wait for room
+
+TEST(StagingAllocatorTest, FreesInAllocationOrder) {
+  StagingAllocator allocator(100);
+  auto a = allocator.try_allocate(40);
+  auto b = allocator.try_allocate(40);
+  ASSERT_TRUE(a && b);
+  EXPECT_EQ(a->offset, 0);
+  EXPECT_EQ(b->offset, 40);
+  EXPECT_FALSE(allocator.try_allocate(40));
+
+  // b can't be freed before a
+  allocator.release(*b, 0);
+  EXPECT_EQ(allocator.get_bytes_in_use(), 80);
+  allocator.release(*a, 0);
+  EXPECT_EQ(allocator.get_bytes_in_use(), 0);
+}
+
+TEST(StagingAllocatorTest, WaitsForTheReleaseSerial) {
+  StagingAllocator allocator(100);
+  auto a = allocator.try_allocate(50);
+  ASSERT_TRUE(a);
+  allocator.release(*a, 2);
+  allocator.complete(1);
+  EXPECT_EQ(allocator.get_bytes_in_use(), 50);
+  allocator.complete(2);
+  EXPECT_EQ(allocator.get_bytes_in_use(), 0);
+}
+
+TEST(StagingAllocatorTest, SkipsTheEndOfTheRing) {
+  StagingAllocator allocator(100);
+  auto a = allocator.try_allocate(60);
+  ASSERT_TRUE(a);
+  allocator.release(*a, 0);
+
+  // 40 bytes are left before the end, so the range starts over at 0
+  auto b = allocator.try_allocate(60);
+  ASSERT_TRUE(b);
+  EXPECT_EQ(b->offset, 0);
+  EXPECT_EQ(allocator.get_bytes_in_use(), 100);
+  EXPECT_FALSE(allocator.try_allocate(1));
+  allocator.release(*b, 0);
+  EXPECT_EQ(allocator.get_bytes_in_use(), 0);
+
+  // a range ending right at the end of the ring doesn't skip anything
+  auto c = allocator.try_allocate(40);
+  ASSERT_TRUE(c);
+  EXPECT_EQ(c->offset, 60);
+  auto d = allocator.try_allocate(20);
+  ASSERT_TRUE(d);
+  EXPECT_EQ(d->offset, 0);
+  EXPECT_EQ(allocator.get_bytes_in_use(), 60);
+}
+
+TEST(StagingAllocatorTest, AllocateWaitsForRoom) {
+  StagingAllocator allocator(100);
+  auto a = allocator.try_allocate(100);
+  ASSERT_TRUE(a);
+
+  std::atomic<bool> allocated = false;
+  std::thread mesher([&] {
+    auto b = allocator.allocate(30);
+    EXPECT_TRUE(b);
+    allocated = true;
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  EXPECT_FALSE(allocated);
+  allocator.release(*a, 1);
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  EXPECT_FALSE(allocated);
+  allocator.complete(1);
+  mesher.join();
+  EXPECT_TRUE(allocated);
+}
+
+TEST(StagingAllocatorTest, CloseWakesWaitingAllocations) {
+  StagingAllocator allocator(100);
+  ASSERT_TRUE(allocator.try_allocate(100));
+  std::thread mesher([&] { EXPECT_FALSE(allocator.allocate(30)); });
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  allocator.close();
+  mesher.join();
+  EXPECT_FALSE(allocator.try_allocate(1));
+}
@@ -0,0 +1,61 @@
+#include "PerlinNoise.hpp"
+#include "terrain_generator.h"
+#include <gtest/gtest.h>
+#include <array>
+#include <cstdint>
+
+// TerrainGenerator::sample_noise (the avx2 kernel on cpus that have it) has to
+// give the heights siv::PerlinNoise itself does, or every world changes
+
+static constexpr double TOLERANCE = 1e-12;
+
+TEST(TerrainGeneratorTest, NoiseMatchesPerlinNoise) {
+  // which path this run compared, without avx2 it is only the scalar one
+  RecordProperty("avx2", TerrainGenerator(0).is_using_avx2() ? 1 : 0);
+
+  static constexpr uint32_t seeds[] = {0, 1, 1234, 0x9e3779b9, UINT32_MAX};
+  // around the origin, negative on either axis, and far out
+  static constexpr ChunkPos positions[] = {
+      {.x = 0, .z = 0},           {.x = -1, .z = -1},
+      {.x = 3, .z = -7},          {.x = -5, .z = 9},
+      {.x = -1000, .z = 1000},    {.x = 123456, .z = -654321},
+      {.x = -(1 << 20), .z = -(1 << 20)},
+  };
+
+  for (auto seed : seeds) {
+    TerrainGenerator terrain_generator(seed);
+    siv::PerlinNoise perlin_noise(seed);
+    for (auto pos : positions) {
+      std::array<double, CHUNK_WIDTH * CHUNK_DEPTH> noise;
+      terrain_generator.sample_noise(pos, noise);
+
+      for (auto z = 0; z < CHUNK_DEPTH; z++) {
+        for (auto x = 0; x < CHUNK_WIDTH; x++) {
+          // NOTE: scaled in float precision, like the generator does
+          double noise_x =
+              (pos.x * CHUNK_WIDTH + x) * TerrainGenerator::PERLIN_SCALE;
+          double noise_y =
+              (pos.z * CHUNK_DEPTH - z) * TerrainGenerator::PERLIN_SCALE;
+          double sample = noise[x + z * CHUNK_WIDTH];
+
+          EXPECT_NEAR(sample,
+                      perlin_noise.octave2D_11(
+                          noise_x, noise_y, TerrainGenerator::PERLIN_OCTAVES,
+                          TerrainGenerator::PERLIN_PERSISTENCE),
+                      TOLERANCE)
+              << "seed " << seed << ", chunk " << pos.x << ", " << pos.z
+              << ", column " << x << ", " << z;
+          // the [0, 1] variant is the same noise remapped
+          EXPECT_NEAR(sample * 0.5 + 0.5,
+                      perlin_noise.octave2D_01(
+                          noise_x, noise_y, TerrainGenerator::PERLIN_OCTAVES,
+                          TerrainGenerator::PERLIN_PERSISTENCE),
+                      TOLERANCE)
+              << "seed " << seed << ", chunk " << pos.x << ", " << pos.z
+              << ", column " << x << ", " << z;
+        }
+      }
+    }
+  }
+}
+
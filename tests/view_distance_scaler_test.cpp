@@ -0,0 +1,113 @@
+#include "view_distance_scaler.h"
+#include <gtest/gtest.h>
+
+// auto view distance: stepping down fast when frames are slow or memory is
+// over budget, growing back slowly, and staying within the limits
+
+namespace {
+
+static constexpr double TARGET_FRAME_MS = 16.7;
+static constexpr int MIN_VIEW_DISTANCE = 4;
+static constexpr int MAX_VIEW_DISTANCE = 12;
+
+static constexpr ViewDistanceScaler::FrameStats SLOW = {
+    .frame_ms = 33.0,
+    .busy_ms = 30.0,
+    .over_memory_budget = false,
+    .memory_headroom = true,
+    .loading = false};
+static constexpr ViewDistanceScaler::FrameStats FAST = {
+    .frame_ms = 16.7,
+    .busy_ms = 5.0,
+    .over_memory_budget = false,
+    .memory_headroom = true,
+    .loading = false};
+
+// a scaler fed frames of fixed stats, frame_ms apart
+class ViewDistanceScalerTest : public testing::Test {
+protected:
+  ViewDistanceScaler scaler{TARGET_FRAME_MS};
+  double time = 0.0;
+  int view_distance = MAX_VIEW_DISTANCE;
+  // times the view distance changed while running
+  int changes = 0;
+
+  void run(double seconds, const ViewDistanceScaler::FrameStats& stats,
+           int max_view_distance = MAX_VIEW_DISTANCE) {
+    for (double end = time + seconds; time < end;
+         time += stats.frame_ms / 1000.0) {
+      int next = scaler.update(time, stats, view_distance, MIN_VIEW_DISTANCE,
+                               max_view_distance);
+      changes += next != view_distance;
+      view_distance = next;
+    }
+  }
+};
+
+} // namespace
+
+TEST_F(ViewDistanceScalerTest, StepsDownOncePerCooldown) {
+  // the first step waits for a cooldown too, from time 0
+  run(0.9, SLOW);
+  EXPECT_EQ(view_distance, MAX_VIEW_DISTANCE);
+  run(0.2, SLOW);
+  EXPECT_EQ(view_distance, MAX_VIEW_DISTANCE - 1);
+  run(2.5, SLOW);
+  EXPECT_EQ(view_distance, MAX_VIEW_DISTANCE - 3);
+  run(20.0, SLOW);
+  EXPECT_EQ(view_distance, MIN_VIEW_DISTANCE);
+}
+
+TEST_F(ViewDistanceScalerTest, GrowsBackSlowly) {
+  run(20.0, SLOW);
+  ASSERT_EQ(view_distance, MIN_VIEW_DISTANCE);
+  // nothing until there has been headroom for 3 seconds
+  run(2.5, FAST);
+  EXPECT_EQ(view_distance, MIN_VIEW_DISTANCE);
+  run(1.0, FAST);
+  EXPECT_EQ(view_distance, MIN_VIEW_DISTANCE + 1);
+  changes = 0;
+  run(60.0, FAST);
+  EXPECT_EQ(view_distance, MAX_VIEW_DISTANCE);
+  // a chunk at a time, never past the max
+  EXPECT_EQ(changes, MAX_VIEW_DISTANCE - MIN_VIEW_DISTANCE - 1);
+}
+
+TEST_F(ViewDistanceScalerTest, StepsDownOverMemoryBudget) {
+  auto stats = FAST;
+  stats.over_memory_budget = true;
+  stats.memory_headroom = false;
+  run(3.5, stats);
+  EXPECT_EQ(view_distance, MAX_VIEW_DISTANCE - 3);
+}
+
+TEST_F(ViewDistanceScalerTest, NoGrowthWithoutHeadroom) {
+  run(20.0, SLOW);
+  ASSERT_EQ(view_distance, MIN_VIEW_DISTANCE);
+
+  auto loading = FAST;
+  loading.loading = true;
+  run(20.0, loading);
+  EXPECT_EQ(view_distance, MIN_VIEW_DISTANCE);
+
+  auto no_memory_headroom = FAST;
+  no_memory_headroom.memory_headroom = false;
+  run(20.0, no_memory_headroom);
+  EXPECT_EQ(view_distance, MIN_VIEW_DISTANCE);
+
+  // vsynced frames at the target, but busy for most of them
+  auto busy = FAST;
+  busy.busy_ms = TARGET_FRAME_MS * 0.8;
+  run(20.0, busy);
+  EXPECT_EQ(view_distance, MIN_VIEW_DISTANCE);
+}
+
+TEST_F(ViewDistanceScalerTest, FollowsLoweredLimit) {
+  run(1.0, FAST);
+  ASSERT_EQ(view_distance, MAX_VIEW_DISTANCE);
+  // the slider was moved down, right away and without growing back
+  run(0.1, FAST, 5);
+  EXPECT_EQ(view_distance, 5);
+  run(20.0, FAST, 5);
+  EXPECT_EQ(view_distance, 5);
+}